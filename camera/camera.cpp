@@ -7,6 +7,8 @@
 
 #include <iostream>
 
+#include "../common/FrameScheduler.h"
+
 const unsigned int window_width = 1000;
 const unsigned int window_height = 800;
 
@@ -38,16 +40,32 @@ const GLchar* fragmentShaderSource =
 "fragmentColor = vec4(vertexColor, 1.0);\n"
 "}\0";
 
-void processInputKeyboard(GLFWwindow* window) {
+// true while a movement key is held, the camera keeps moving and needs the next frame
+bool processInputKeyboard(GLFWwindow* window) {
     const float cameraSpeed = 0.003f;
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    bool moving = false;
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
         cameraPosition += cameraSpeed * cameraFront;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        moving = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
         cameraPosition -= cameraSpeed * cameraFront;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        moving = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
         cameraPosition -= glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        moving = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
         cameraPosition += glm::normalize(glm::cross(cameraFront, cameraUp)) * cameraSpeed;
+        moving = true;
+    }
+    return moving;
+}
+
+// any key press or release may start or stop the movement
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    FrameScheduler::of(window)->invalidate();
 }
 
 void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
@@ -75,6 +93,7 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
     cameraFront_new.y = sin(glm::radians(pitch));
     cameraFront_new.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
     cameraFront = glm::normalize(cameraFront_new);
+    FrameScheduler::of(window)->invalidate();
 }
 
 int main() {
@@ -207,20 +226,24 @@ int main() {
     GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
     glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 
+    // bez ruchu myszy i klawiszy petla spi w glfwWaitEvents
+    FrameScheduler frames(window);
+
     // scroll callback
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetCursorPosCallback(window, mouseCallback);
+    glfwSetKeyCallback(window, keyCallback);
         
     // macierz projekcji
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(window_width) / static_cast<float>(window_height), 0.1f, 100.0f);
     GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
     glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
-    while (!glfwWindowShouldClose(window)) {
+    while (frames.waitForFrame()) {
         glClearColor(0.2f, 0.1f, 0.141f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        processInputKeyboard(window);
+        if (processInputKeyboard(window)) frames.invalidate();
 
         // aktualizacja widoku kamery
         view = glm::lookAt(cameraPosition, cameraPosition + cameraFront, cameraUp);
@@ -233,7 +256,6 @@ int main() {
         glBindVertexArray(0);
 
         glfwSwapBuffers(window);
-        glfwPollEvents();
     }
 
     glDeleteVertexArrays(1, &VAO);
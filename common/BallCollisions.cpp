@@ -0,0 +1,226 @@
+#include "BallCollisions.h"
+
+#include "ParticleSystem.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+static const unsigned LARGE = 0xFFFFFFFFu;
+
+BallCollisions::BallCollisions(float cellSize) : cellSize(cellSize > 0.0f ? cellSize : 1.0f) {
+}
+
+void BallCollisions::build(const ParticleSystem& balls) {
+	size_t count = balls.size();
+	columns = (int)std::ceil(balls.boundsWidth() / cellSize);
+	rows = (int)std::ceil(balls.boundsHeight() / cellSize);
+	if (columns < 1) columns = 1;
+	if (rows < 1) rows = 1;
+	size_t cells = (size_t)columns * rows;
+
+	cellOf.resize(count);
+	cellStart.assign(cells + 1, 0);
+	largeBalls.clear();
+	largestSmallRadius = 0.0f;
+
+	// count: cellStart[c + 1] = balls in cell c
+	float inverse = 1.0f / cellSize;
+	for (size_t i = 0; i < count; i++) {
+		float r = balls.radius[i];
+		if (2.0f * r > cellSize) {
+			cellOf[i] = LARGE;
+			largeBalls.push_back((unsigned)i);
+			continue;
+		}
+		if (r > largestSmallRadius) largestSmallRadius = r;
+		int cx = (int)(balls.x[i] * inverse), cy = (int)(balls.y[i] * inverse);
+		cx = cx < 0 ? 0 : (cx >= columns ? columns - 1 : cx);
+		cy = cy < 0 ? 0 : (cy >= rows ? rows - 1 : cy);
+		unsigned cell = (unsigned)(cy * columns + cx);
+		cellOf[i] = cell;
+		cellStart[cell + 1]++;
+	}
+
+	// prefix sum, then scatter; cellStart[c] is used as the write cursor and shifted back after
+	for (size_t c = 1; c <= cells; c++)
+		cellStart[c] += cellStart[c - 1];
+	size_t small = cellStart[cells];
+	sortedBalls.resize(small);
+	for (size_t i = 0; i < count; i++)
+		if (cellOf[i] != LARGE) sortedBalls[cellStart[cellOf[i]]++] = (unsigned)i;
+	for (size_t c = cells; c > 0; c--)
+		cellStart[c] = cellStart[c - 1];
+	cellStart[0] = 0;
+
+	// one random read per ball here instead of one per neighbour test later
+	sortedX.resize(small); sortedY.resize(small);
+	sortedVX.resize(small); sortedVY.resize(small);
+	sortedRadius.resize(small);
+	for (size_t k = 0; k < small; k++) {
+		unsigned i = sortedBalls[k];
+		sortedX[k] = balls.x[i];
+		sortedY[k] = balls.y[i];
+		sortedVX[k] = balls.vx[i];
+		sortedVY[k] = balls.vy[i];
+		sortedRadius[k] = balls.radius[i];
+	}
+}
+
+// visit(k) for every sorted small ball whose cell can hold a centre touching (px, py, r)
+template <typename Visit>
+void BallCollisions::forNeighbours(float px, float py, float r, Visit visit) const {
+	float inverse = 1.0f / cellSize;
+	float reach = r + largestSmallRadius;
+	int x0 = (int)((px - reach) * inverse), x1 = (int)((px + reach) * inverse);
+	int y0 = (int)((py - reach) * inverse), y1 = (int)((py + reach) * inverse);
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 >= columns ? columns - 1 : x1;
+	y1 = y1 >= rows ? rows - 1 : y1;
+	for (int cy = y0; cy <= y1; cy++) {
+		// the cells of one row are next to each other in sortedBalls
+		const unsigned* row = cellStart.data() + cy * columns;
+		for (unsigned k = row[x0]; k < row[x1 + 1]; k++)
+			visit(k);
+	}
+}
+
+// one contact, both balls changed in place (mass ~ r * r): each takes its share of the overlap and
+// an elastic exchange along the normal while approaching, which keeps momentum and kinetic
+// energy of the pair; false when apart
+static inline bool collide(float& ax, float& ay, float& avx, float& avy, float ar,
+	float& bx, float& by, float& bvx, float& bvy, float br) {
+	float ox = bx - ax, oy = by - ay;
+	float reach = ar + br;
+	float distance2 = ox * ox + oy * oy;
+	if (distance2 >= reach * reach || distance2 == 0.0f) return false;
+
+	float distance = std::sqrt(distance2);
+	float nx = ox / distance, ny = oy / distance;
+	float shareA = br * br / (ar * ar + br * br), shareB = 1.0f - shareA;
+
+	// heavier neighbours push harder
+	float overlap = reach - distance;
+	ax -= nx * overlap * shareA;
+	ay -= ny * overlap * shareA;
+	bx += nx * overlap * shareB;
+	by += ny * overlap * shareB;
+
+	float approach = (bvx - avx) * nx + (bvy - avy) * ny;
+	if (approach < 0.0f) {
+		avx += 2.0f * shareA * approach * nx;
+		avy += 2.0f * shareA * approach * ny;
+		bvx -= 2.0f * shareB * approach * nx;
+		bvy -= 2.0f * shareB * approach * ny;
+	}
+	return true;
+}
+
+bool BallCollisions::collideSorted(size_t k, size_t n) {
+	if (!collide(sortedX[k], sortedY[k], sortedVX[k], sortedVY[k], sortedRadius[k],
+		sortedX[n], sortedY[n], sortedVX[n], sortedVY[n], sortedRadius[n]))
+		return false;
+	sortedTouched[k] = sortedTouched[n] = 1;
+	return true;
+}
+
+// cells (phaseX + 3 i, phaseY + 2 j) for i * j in [begin, end): every pair is handled from the
+// cell of its lower sorted index, looking only at the rest of the cell, the next cell in the row
+// and three cells of the row below; cells of one phase are 3 columns or 2 rows apart, so what
+// they touch never overlaps and the pool runs them without locks
+size_t BallCollisions::collideCells(int phaseX, int phaseY, size_t begin, size_t end) {
+	size_t contacts = 0;
+	int phaseColumns = (columns - phaseX + 2) / 3;
+	for (size_t j = begin; j < end; j++) {
+		int cx = phaseX + 3 * (int)(j % phaseColumns), cy = phaseY + 2 * (int)(j / phaseColumns);
+		const unsigned* row = cellStart.data() + cy * columns;
+		unsigned rightEnd = row[cx + 2 <= columns ? cx + 2 : columns];
+		unsigned belowBegin = 0, belowEnd = 0;
+		if (cy + 1 < rows) {
+			const unsigned* below = row + columns;
+			belowBegin = below[cx > 0 ? cx - 1 : 0];
+			belowEnd = below[cx + 2 <= columns ? cx + 2 : columns];
+		}
+		for (unsigned k = row[cx]; k < row[cx + 1]; k++) {
+			for (unsigned n = k + 1; n < rightEnd; n++)
+				contacts += collideSorted(k, n);
+			for (unsigned n = belowBegin; n < belowEnd; n++)
+				contacts += collideSorted(k, n);
+		}
+	}
+	return contacts;
+}
+
+// the few balls wider than a cell, against everything, after the small ones
+size_t BallCollisions::collideLarge(ParticleSystem& balls) {
+	size_t contacts = 0;
+	for (size_t a = 0; a < largeBalls.size(); a++) {
+		unsigned i = largeBalls[a];
+		forNeighbours(balls.x[i], balls.y[i], balls.radius[i], [&](unsigned n) {
+			if (collide(balls.x[i], balls.y[i], balls.vx[i], balls.vy[i], balls.radius[i],
+				sortedX[n], sortedY[n], sortedVX[n], sortedVY[n], sortedRadius[n])) {
+				sortedTouched[n] = 1;
+				balls.events[i] |= EVENT_BALL;
+				contacts++;
+			}
+		});
+		for (size_t b = a + 1; b < largeBalls.size(); b++) {
+			unsigned j = largeBalls[b];
+			if (collide(balls.x[i], balls.y[i], balls.vx[i], balls.vy[i], balls.radius[i],
+				balls.x[j], balls.y[j], balls.vx[j], balls.vy[j], balls.radius[j])) {
+				balls.events[i] |= EVENT_BALL;
+				balls.events[j] |= EVENT_BALL;
+				contacts++;
+			}
+		}
+	}
+	return contacts;
+}
+
+void BallCollisions::resolve(ParticleSystem& balls, ThreadPool* pool) {
+	typedef std::chrono::steady_clock Clock;
+	size_t count = balls.size();
+
+	Clock::time_point start = Clock::now();
+	build(balls);
+	Clock::time_point built = Clock::now();
+
+	size_t small = sortedBalls.size();
+	sortedTouched.assign(small, 0);
+	bool parallel = pool && count > ParticleSystem::STEP_BLOCK;
+
+	// Gauss-Seidel: every contact sees the velocities already changed by the earlier ones, so a
+	// ball between several others gets one bounce after another, never the sum of full bounces
+	std::atomic<size_t> contacts(0);
+	for (int phaseY = 0; phaseY < 2; phaseY++) {
+		for (int phaseX = 0; phaseX < 3; phaseX++) {
+			size_t cells = (size_t)((columns - phaseX + 2) / 3) * ((rows - phaseY + 1) / 2);
+			auto narrow = [&](size_t begin, size_t end) {
+				contacts += collideCells(phaseX, phaseY, begin, end);
+			};
+			if (parallel) pool->parallelFor(cells, narrow);
+			else narrow(0, cells);
+		}
+	}
+	contacts += collideLarge(balls);
+
+	auto apply = [&](size_t begin, size_t end) {
+		for (size_t k = begin; k < end; k++) {
+			unsigned i = sortedBalls[k];
+			balls.x[i] = sortedX[k];
+			balls.y[i] = sortedY[k];
+			balls.vx[i] = sortedVX[k];
+			balls.vy[i] = sortedVY[k];
+			if (sortedTouched[k]) balls.events[i] |= EVENT_BALL;
+		}
+	};
+	if (parallel) pool->parallelFor(small, apply);
+	else apply(0, small);
+	Clock::time_point resolved = Clock::now();
+
+	last.buildMilliseconds = std::chrono::duration<double, std::milli>(built - start).count();
+	last.narrowMilliseconds = std::chrono::duration<double, std::milli>(resolved - built).count();
+	last.contacts = contacts;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+class ParticleSystem;
+class ThreadPool;
+/*
+	Ball-ball collisions for a ParticleSystem, broad phase on a uniform grid,
+		HOW TO USE IT:
+	* construct it with the cell size, about the diameter of a typical ball; balls wider than a
+	  cell are kept in a separate list that every ball tests directly
+	* resolve(balls, pool) once per step before balls.step(): the grid is rebuilt with a counting
+	  sort into flat arrays (cell start offsets + body indices, no per-cell allocation, the arrays
+	  only grow) and the ball state is gathered in cell order, so the neighbouring cells every
+	  ball looks at are contiguous in memory
+	* the narrow phase is Gauss-Seidel: contacts are handled one after another on the gathered
+	  state, each an elastic exchange between the two balls, so a ball touching several others
+	  bounces off them in turn and no energy is added; the grid is walked in 6 phases of cells far
+	  enough apart to be split across the pool without locks, the balls wider than a cell go
+	  last on the calling thread; the result is written back in one pass, which also sets
+	  EVENT_BALL in balls.events for every ball that touched another
+	* timings() gives the milliseconds of the last build and narrow phase and the contact count
+*/
+struct CollisionTimings
+{
+	double buildMilliseconds = 0.0;
+	double narrowMilliseconds = 0.0;
+	size_t contacts = 0;
+};
+
+class BallCollisions
+{
+public:
+	explicit BallCollisions(float cellSize);
+
+	void resolve(ParticleSystem& balls, ThreadPool* pool = nullptr);
+	const CollisionTimings& timings() const { return last; }
+
+private:
+	float cellSize;
+	int columns = 0, rows = 0;
+	float largestSmallRadius = 0.0f;
+	std::vector<unsigned> cellOf;		// per ball, LARGE for the separate list
+	std::vector<unsigned> cellStart;	// columns * rows + 1 offsets into sortedBalls
+	std::vector<unsigned> sortedBalls;
+	std::vector<unsigned> largeBalls;
+	std::vector<float> sortedX, sortedY, sortedVX, sortedVY, sortedRadius;
+	std::vector<unsigned char> sortedTouched;
+	CollisionTimings last;
+
+	void build(const ParticleSystem& balls);
+	template <typename Visit>
+	void forNeighbours(float px, float py, float r, Visit visit) const;
+	bool collideSorted(size_t k, size_t n);
+	size_t collideCells(int phaseX, int phaseY, size_t begin, size_t end);
+	size_t collideLarge(ParticleSystem& balls);
+};
@@ -0,0 +1,253 @@
+#include "Batch2D.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "Shapes2D.h"
+
+static const char* vertexSource =
+	"#version 330 core\n"
+	"layout(location = 0) in vec2 aPos;\n"
+	"layout(location = 1) in vec2 aUv;\n"
+	"layout(location = 2) in vec4 aColor;\n"
+	"uniform mat4 projection;\n"
+	"out vec2 uv;\n"
+	"out vec4 color;\n"
+	"void main() {\n"
+	"    uv = aUv;\n"
+	"    color = aColor;\n"
+	"    gl_Position = projection * vec4(aPos, 0.0, 1.0);\n"
+	"}\n";
+
+static const char* fragmentSource =
+	"#version 330 core\n"
+	"in vec2 uv;\n"
+	"in vec4 color;\n"
+	"uniform sampler2D image;\n"
+	"out vec4 fragmentColor;\n"
+	"void main() {\n"
+	"    fragmentColor = texture(image, uv) * color;\n"
+	"}\n";
+
+static GLuint compileStage(GLenum type, const char* source) {
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		GLchar message[512];
+		glGetShaderInfoLog(shader, 512, nullptr, message);
+		std::cout << "Error (Batch2D shader): " << message << std::endl;
+	}
+	return shader;
+}
+
+bool Batch2D::create() {
+	GLuint vertexShader = compileStage(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = compileStage(GL_FRAGMENT_SHADER, fragmentSource);
+	program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glLinkProgram(program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+	GLint status;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (!status) {
+		GLchar message[512];
+		glGetProgramInfoLog(program, 512, nullptr, message);
+		std::cout << "Error (Batch2D program): " << message << std::endl;
+		return false;
+	}
+	projectionLocation = glGetUniformLocation(program, "projection");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "image"), 0);
+
+	const unsigned white = 0xFFFFFFFFu;
+	glGenTextures(1, &whiteTexture);
+	glBindTexture(GL_TEXTURE_2D, whiteTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glGenBuffers(1, &ebo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(4 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+	return true;
+}
+
+void Batch2D::destroy() {
+	if (vao) glDeleteVertexArrays(1, &vao);
+	if (vbo) glDeleteBuffers(1, &vbo);
+	if (ebo) glDeleteBuffers(1, &ebo);
+	if (whiteTexture) glDeleteTextures(1, &whiteTexture);
+	if (program) glDeleteProgram(program);
+	vao = vbo = ebo = whiteTexture = program = 0;
+	vertexCapacity = indexCapacity = 0;
+}
+
+void Batch2D::begin(const float* projection) {
+	vertices.clear();
+	indices.clear();
+	shapes.clear();
+	currentLayer = 0x8000;
+	currentBlend = BlendMode::Alpha;
+	glUseProgram(program);
+	glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, projection);
+}
+
+// layer in the top bits, then blend mode, then texture: runs of one key are one draw
+uint64_t Batch2D::key(GLuint texture) const {
+	return (uint64_t)currentLayer << 48 | (uint64_t)currentBlend << 40 | (uint64_t)(texture ? texture : whiteTexture);
+}
+
+// corners in the order top left, top right, bottom left, bottom right
+void Batch2D::addQuad(GLuint texture, const float* corners, const float* uvs, const unsigned* colors) {
+	unsigned first = (unsigned)vertices.size();
+	for (int i = 0; i < 4; i++)
+		vertices.push_back({ corners[2 * i], corners[2 * i + 1], uvs[2 * i], uvs[2 * i + 1], colors[i] });
+
+	unsigned firstIndex = (unsigned)indices.size();
+	const unsigned quad[] = { 0, 1, 2, 2, 1, 3 };
+	for (unsigned i : quad)
+		indices.push_back(first + i);
+	shapes.push_back({ key(texture), firstIndex, 6 });
+}
+
+void Batch2D::drawRect(float x, float y, float width, float height, unsigned color) {
+	const float corners[] = { x, y, x + width, y, x, y + height, x + width, y + height };
+	const float uvs[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+	const unsigned colors[] = { color, color, color, color };
+	addQuad(0, corners, uvs, colors);
+}
+
+// a quad thickness wide around the segment
+void Batch2D::drawLine(float x0, float y0, float x1, float y1, float thickness, unsigned color0, unsigned color1) {
+	float dx = x1 - x0, dy = y1 - y0;
+	float length = std::sqrt(dx * dx + dy * dy);
+	if (length == 0.0f) return;
+	float nx = -dy / length * thickness * 0.5f, ny = dx / length * thickness * 0.5f;
+
+	const float corners[] = { x0 + nx, y0 + ny, x1 + nx, y1 + ny, x0 - nx, y0 - ny, x1 - nx, y1 - ny };
+	const float uvs[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+	const unsigned colors[] = { color0, color1, color0, color1 };
+	addQuad(0, corners, uvs, colors);
+}
+
+void Batch2D::drawQuad(GLuint texture, float x, float y, float width, float height, unsigned color,
+	float u0, float v0, float u1, float v1) {
+	const float corners[] = { x, y, x + width, y, x, y + height, x + width, y + height };
+	const float uvs[] = { u0, v0, u1, v0, u0, v1, u1, v1 };
+	const unsigned colors[] = { color, color, color, color };
+	addQuad(texture, corners, uvs, colors);
+}
+
+const std::vector<float>& Batch2D::unitCircle(int segments) {
+	if ((size_t)segments >= unitCircles.size()) unitCircles.resize(segments + 1);
+	std::vector<float>& rim = unitCircles[segments];
+	if (rim.empty()) {
+		rim.resize(2 * segments);
+		sincosSteps(0.0f, 6.2831853f / segments, segments, rim.data(), rim.data() + segments);
+	}
+	return rim;
+}
+
+// a fan as GL_TRIANGLES, so circles join the same draw as the quads
+void Batch2D::drawCircle(float cx, float cy, float radius, unsigned color) {
+	int segments = circleSegmentsForError(radius, maxCircleError, 8, 256);
+	const std::vector<float>& rim = unitCircle(segments);
+	const float* cosines = rim.data();
+	const float* sines = rim.data() + segments;
+
+	unsigned center = (unsigned)vertices.size();
+	vertices.push_back({ cx, cy, 0.5f, 0.5f, color });
+	for (int i = 0; i < segments; i++)
+		vertices.push_back({ cx + radius * cosines[i], cy + radius * sines[i], 0.5f, 0.5f, color });
+
+	unsigned firstIndex = (unsigned)indices.size();
+	for (int i = 0; i < segments; i++) {
+		unsigned next = i + 1 < segments ? i + 2 : 1;
+		indices.push_back(center);
+		indices.push_back(center + i + 1);
+		indices.push_back(center + next);
+	}
+	shapes.push_back({ key(0), firstIndex, (unsigned)segments * 3 });
+}
+
+void Batch2D::applyBlend(BlendMode mode) {
+	if (mode == BlendMode::Opaque) {
+		glDisable(GL_BLEND);
+		return;
+	}
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, mode == BlendMode::Additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Batch2D::end() {
+	lastShapes = shapes.size();
+	lastDrawCalls = 0;
+	if (shapes.empty()) return;
+
+	// submission order breaks ties, firstIndex grows with it
+	auto byKey = [](const Shape& a, const Shape& b) {
+		return a.key != b.key ? a.key < b.key : a.firstIndex < b.firstIndex;
+	};
+	bool sorted = std::is_sorted(shapes.begin(), shapes.end(), byKey);
+	if (!sorted) std::sort(shapes.begin(), shapes.end(), byKey);
+
+	glBindVertexArray(vao);
+
+	// orphan both buffers (the GPU may still read last frame's), grow them only when needed
+	size_t vertexBytes = vertices.size() * sizeof(Vertex), indexBytes = indices.size() * sizeof(unsigned);
+	if (vertices.size() > vertexCapacity) vertexCapacity = vertices.size() + vertices.size() / 2;
+	if (indices.size() > indexCapacity) indexCapacity = indices.size() + indices.size() / 2;
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexCapacity * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertexBytes, vertices.data());
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned), nullptr, GL_STREAM_DRAW);
+	if (sorted) {
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, indices.data());
+	}
+	else {
+		unsigned* mapped = (unsigned*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!mapped) return;
+		unsigned* out = mapped;
+		for (const Shape& shape : shapes) {
+			std::memcpy(out, indices.data() + shape.firstIndex, shape.indexCount * sizeof(unsigned));
+			out += shape.indexCount;
+		}
+		glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	size_t offset = 0;
+	for (size_t first = 0; first < shapes.size();) {
+		uint64_t runKey = shapes[first].key;
+		size_t count = 0, last = first;
+		for (; last < shapes.size() && shapes[last].key == runKey; last++)
+			count += shapes[last].indexCount;
+
+		applyBlend((BlendMode)(runKey >> 40 & 0xFF));
+		glBindTexture(GL_TEXTURE_2D, (GLuint)(runKey & 0xFFFFFFFFu));
+		glDrawElements(GL_TRIANGLES, (GLsizei)count, GL_UNSIGNED_INT, (void*)(offset * sizeof(unsigned)));
+		lastDrawCalls++;
+
+		offset += count;
+		first = last;
+	}
+	glBindVertexArray(0);
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Color.h"
+/*
+	Immediate-mode 2D drawing collected into one streamed vertex / index buffer per frame,
+		HOW TO USE IT:
+	* create() once the GL context is current (program, 1x1 white texture, VAO and the two
+	  buffers), destroy() before the context goes away
+	* every frame: begin(projection) with a column-major mat4 (e.g. an ortho in pixels), any
+	  number of drawRect / drawLine / drawCircle / drawQuad, then end()
+	* colors are packed RGBA8 (r in the lowest byte, packColor); untextured shapes sample the
+	  white texture, so all four kinds share one program and differ only by the bound texture
+	* every shape gets the key (layer, blend, texture); end() sorts the shapes by key, keeping
+	  the submission order within a key, writes the indices in that order into the orphaned
+	  index buffer, uploads all vertices once and issues one glDrawElements per run of equal
+	  keys - 100k shapes on one texture and blend mode are a single draw
+	* shapes that must overlap in a fixed order across textures or blend modes go on different
+	  layers (setLayer); end() leaves blending in the state of the last run
+	* circle segments come from circleSegmentsForError with the radius taken as pixels, the
+	  unit circle of each segment count is computed once and cached
+	* nothing is allocated once the CPU arrays and GL buffers have grown to the frame's size
+*/
+enum class BlendMode : uint8_t { Opaque, Alpha, Additive };
+
+class Batch2D
+{
+public:
+	bool create();
+	void destroy();
+
+	void begin(const float* projection);
+	void end();
+
+	void setLayer(int layer) { currentLayer = (uint16_t)(layer + 0x8000); }
+	void setBlend(BlendMode mode) { currentBlend = mode; }
+
+	void drawRect(float x, float y, float width, float height, unsigned color);
+	void drawLine(float x0, float y0, float x1, float y1, float thickness, unsigned color0, unsigned color1);
+	void drawLine(float x0, float y0, float x1, float y1, float thickness, unsigned color) {
+		drawLine(x0, y0, x1, y1, thickness, color, color);
+	}
+	void drawCircle(float cx, float cy, float radius, unsigned color);
+	void drawQuad(GLuint texture, float x, float y, float width, float height, unsigned color = 0xFFFFFFFFu,
+		float u0 = 0.0f, float v0 = 0.0f, float u1 = 1.0f, float v1 = 1.0f);
+
+	// of the last end()
+	int drawCalls() const { return lastDrawCalls; }
+	size_t shapeCount() const { return lastShapes; }
+
+	float maxCircleError = 0.25f;
+
+private:
+	struct Vertex
+	{
+		float x, y, u, v;
+		unsigned color;
+	};
+	struct Shape
+	{
+		uint64_t key;
+		unsigned firstIndex, indexCount;
+	};
+
+	GLuint program = 0, whiteTexture = 0;
+	GLuint vao = 0, vbo = 0, ebo = 0;
+	GLint projectionLocation = -1;
+	size_t vertexCapacity = 0, indexCapacity = 0;
+
+	uint16_t currentLayer = 0x8000;
+	BlendMode currentBlend = BlendMode::Alpha;
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned> indices;
+	std::vector<Shape> shapes;
+	std::vector<std::vector<float>> unitCircles;	// per segment count: cos..., sin...
+
+	int lastDrawCalls = 0;
+	size_t lastShapes = 0;
+
+	uint64_t key(GLuint texture) const;
+	void addQuad(GLuint texture, const float* corners, const float* uvs, const unsigned* colors);
+	const std::vector<float>& unitCircle(int segments);
+	void applyBlend(BlendMode mode);
+};
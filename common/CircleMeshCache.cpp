@@ -0,0 +1,60 @@
+#include "CircleMeshCache.h"
+
+#include "Shapes2D.h"
+
+CircleMeshCache::CircleMeshCache(float radius, int minSegments, int maxSegments, bool texCoords)
+	: first(minSegments < 3 ? 3 : minSegments), last(maxSegments < first ? first : maxSegments), texCoords(texCoords) {
+	size_t vertexCount = 0, indexTotal = 0;
+	for (int n = first; n <= last; n++) {
+		vertexCount += circleSize(n, ShapeTopology::Restart).vertices;
+		indexTotal += circleSize(n, ShapeTopology::Restart).indices;
+	}
+	vertices.resize(vertexCount * floatsPerVertex());
+	indices.resize(indexTotal);
+	firstIndex.reserve(last - first + 2);
+
+	ShapeOutput out;
+	out.stride = floatsPerVertex();
+	out.positionComponents = 3;
+	out.uvOffset = texCoords ? 3 : -1;
+	out.topology = ShapeTopology::Restart;
+	size_t vertex = 0, index = 0;
+	for (int n = first; n <= last; n++) {
+		firstIndex.push_back(index);
+		out.vertices = vertices.data() + vertex * out.stride;
+		out.indices = indices.data() + index;
+		out.baseVertex = (unsigned)vertex;
+		ShapeSize size = writeCircle(out, 0.0f, 0.0f, radius, n);
+		vertex += size.vertices;
+		index += size.indices;
+	}
+	firstIndex.push_back(index);
+}
+
+void CircleMeshCache::upload(GLuint vbo, GLuint ebo) {
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+	std::vector<float>().swap(vertices);
+	std::vector<unsigned>().swap(indices);
+}
+
+int CircleMeshCache::clamp(int segments) const {
+	return segments < first ? first : (segments > last ? last : segments);
+}
+
+GLsizei CircleMeshCache::indexCount(int segments) const {
+	// one fan per mesh, the trailing restart index is not drawn
+	int n = clamp(segments) - first;
+	return (GLsizei)(firstIndex[n + 1] - firstIndex[n] - 1);
+}
+
+const void* CircleMeshCache::indexOffset(int segments) const {
+	return (const void*)(firstIndex[clamp(segments) - first] * sizeof(unsigned));
+}
+
+void CircleMeshCache::draw(int segments) const {
+	glDrawElements(GL_TRIANGLE_FAN, indexCount(segments), GL_UNSIGNED_INT, indexOffset(segments));
+}
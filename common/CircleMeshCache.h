@@ -0,0 +1,37 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+/*
+	Every circle tessellation between minSegments and maxSegments, built once into one VBO/EBO,
+		HOW TO USE IT:
+	* construct it with the radius and segment range (no GL calls), then upload(VBO, EBO) once
+	  with the VAO bound and set the attribute pointers as usual
+	  (position xyz, + texture uv when texCoords, floatsPerVertex() floats per vertex)
+	* draw(N) is a single GL_TRIANGLE_FAN glDrawElements with that mesh's offset and count (N + 2
+	  indices instead of 3N triangles) - changing N (scroll) allocates nothing and uploads nothing
+	* indices are absolute, so no base vertex is needed
+*/
+class CircleMeshCache
+{
+public:
+	CircleMeshCache(float radius, int minSegments, int maxSegments, bool texCoords);
+
+	void upload(GLuint vbo, GLuint ebo);
+	void draw(int segments) const;
+
+	int clamp(int segments) const;
+	GLsizei indexCount(int segments) const;
+	const void* indexOffset(int segments) const;
+	int floatsPerVertex() const { return texCoords ? 5 : 3; }
+	int minSegments() const { return first; }
+	int maxSegments() const { return last; }
+
+private:
+	int first, last;
+	bool texCoords;
+	std::vector<float> vertices;		// freed after upload()
+	std::vector<unsigned> indices;
+	std::vector<size_t> firstIndex;		// per segment count, plus one past the end
+};
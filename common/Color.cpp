@@ -0,0 +1,6 @@
+#include "Color.h"
+
+unsigned packColor(float r, float g, float b, float a) {
+	auto channel = [](float v) { return (unsigned)(v < 0.0f ? 0.0f : (v > 1.0f ? 255.0f : v * 255.0f + 0.5f)); };
+	return channel(r) | channel(g) << 8 | channel(b) << 16 | channel(a) << 24;
+}
@@ -0,0 +1,10 @@
+#pragma once
+/*
+	Colors packed into one 32-bit RGBA8 value,
+		HOW TO USE IT:
+	* packColor(r, g, b, a) takes channels in [0, 1] (clamped, rounded to 8 bits) and puts r in
+	  the lowest byte, a in the highest - the layout of a GL_UNSIGNED_BYTE x4 vertex attribute on
+	  a little-endian CPU, shared by Batch2D vertices and ParticleSystem instances
+	* a defaults to 1 (opaque)
+*/
+unsigned packColor(float r, float g, float b, float a = 1.0f);
@@ -0,0 +1,58 @@
+#include "DirtyRegion.h"
+
+static inline float area(const DirtyRect& r) {
+	return (r.right - r.left) * (r.bottom - r.top);
+}
+
+static inline bool overlaps(const DirtyRect& a, const DirtyRect& b) {
+	return a.left <= b.right && b.left <= a.right && a.top <= b.bottom && b.top <= a.bottom;
+}
+
+static inline void merge(DirtyRect& into, const DirtyRect& r) {
+	if (r.left < into.left) into.left = r.left;
+	if (r.top < into.top) into.top = r.top;
+	if (r.right > into.right) into.right = r.right;
+	if (r.bottom > into.bottom) into.bottom = r.bottom;
+}
+
+void DirtyRegion::setBounds(float width, float height) {
+	this->width = width;
+	this->height = height;
+}
+
+void DirtyRegion::markAll() {
+	dirty.assign(1, { 0.0f, 0.0f, width, height });
+}
+
+void DirtyRegion::add(float left, float top, float right, float bottom) {
+	DirtyRect r = { left < 0.0f ? 0.0f : left, top < 0.0f ? 0.0f : top,
+		right > width ? width : right, bottom > height ? height : bottom };
+	if (r.left >= r.right || r.top >= r.bottom) return;
+
+	// a grown rect can reach others it did not touch before, so merge until nothing overlaps
+	for (size_t i = 0; i < dirty.size();) {
+		if (overlaps(dirty[i], r)) {
+			merge(r, dirty[i]);
+			dirty[i] = dirty.back();
+			dirty.pop_back();
+			i = 0;
+		}
+		else {
+			i++;
+		}
+	}
+	dirty.push_back(r);
+
+	if ((int)dirty.size() > MAX_RECTS || coverage() > 0.5f) {
+		DirtyRect all = dirty[0];
+		for (const DirtyRect& d : dirty) merge(all, d);
+		dirty.assign(1, all);
+	}
+}
+
+float DirtyRegion::coverage() const {
+	if (width <= 0.0f || height <= 0.0f) return 0.0f;
+	float covered = 0.0f;
+	for (const DirtyRect& r : dirty) covered += area(r);
+	return covered / (width * height);
+}
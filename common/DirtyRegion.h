@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+/*
+	Changed areas of a retained 2D scene between two presented frames,
+		HOW TO USE IT:
+	* setBounds(width, height) with the scene size, then add(left, top, right, bottom) the old
+	  and the new bounds of everything that moved, appeared, disappeared or changed color
+	* markAll() after anything that changes the whole picture (resize, another shader, ...)
+	* rects() are the areas to redraw (glScissor each one over the preserved image), empty()
+	  means nothing changed and the frame does not have to be drawn or presented at all
+	* overlapping rects are merged; past MAX_RECTS, or when they cover most of the scene,
+	  everything collapses to one rect, so the number of redraw passes stays small
+*/
+struct DirtyRect
+{
+	float left, top, right, bottom;
+};
+
+class DirtyRegion
+{
+public:
+	static const int MAX_RECTS = 8;
+
+	void setBounds(float width, float height);
+	void add(float left, float top, float right, float bottom);
+	void markAll();
+	void clear() { dirty.clear(); }
+
+	bool empty() const { return dirty.empty(); }
+	const std::vector<DirtyRect>& rects() const { return dirty; }
+	// share of the scene covered by the rects, for reporting
+	float coverage() const;
+
+private:
+	float width = 0.0f, height = 0.0f;
+	std::vector<DirtyRect> dirty;
+};
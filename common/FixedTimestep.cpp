@@ -0,0 +1,69 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(double stepSeconds, int maxSteps)
+	: stepSeconds(stepSeconds > 0.0 ? stepSeconds : 1.0 / 60.0), maxSteps(maxSteps > 0 ? maxSteps : 1) {
+}
+
+int FixedTimestep::advance(double frameSeconds) {
+	if (frameSeconds > 0.0) accumulator += frameSeconds;
+
+	int steps = (int)(accumulator / stepSeconds);
+	if (steps > maxSteps) {
+		steps = maxSteps;
+		accumulator = 0.0;
+	}
+	else {
+		accumulator -= steps * stepSeconds;
+	}
+	return steps;
+}
+
+SimulationThread::SimulationThread(std::function<void(int steps)> stepFunction)
+	: stepFunction(std::move(stepFunction)) {
+	thread = std::thread(&SimulationThread::loop, this);
+}
+
+SimulationThread::~SimulationThread() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	thread.join();
+}
+
+void SimulationThread::start(int steps) {
+	if (steps <= 0) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending += steps;
+		busy = true;
+	}
+	condition.notify_all();
+}
+
+void SimulationThread::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] { return !busy; });
+}
+
+void SimulationThread::loop() {
+	for (;;) {
+		int steps;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stopping || pending > 0; });
+			if (stopping) return;
+			steps = pending;
+			pending = 0;
+		}
+
+		stepFunction(steps);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (pending == 0) busy = false;
+		}
+		condition.notify_all();
+	}
+}
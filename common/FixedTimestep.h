@@ -0,0 +1,52 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+/*
+	Fixed-rate simulation independent of the frame rate,
+		HOW TO USE IT:
+	* FixedTimestep(1.0 / hz): every frame advance(frameSeconds) returns how many fixed steps to
+	  run, alpha() is the leftover fraction of a step for interpolating the last two states
+	* frame spikes are capped at maxSteps per frame (the rest of the time is dropped) so a slow
+	  frame cannot start a spiral of ever more steps
+	* SimulationThread runs the steps on its own thread: start(steps) returns at once, wait()
+	  blocks until they are done; the step function may use ThreadPool::parallelFor, and the
+	  simulation state must only be touched by the caller between wait() and the next start()
+*/
+class FixedTimestep
+{
+public:
+	explicit FixedTimestep(double stepSeconds, int maxSteps = 8);
+
+	int advance(double frameSeconds);
+	float alpha() const { return (float)(accumulator / stepSeconds); }
+	double step() const { return stepSeconds; }
+	void setRate(double hz) { if (hz > 0.0) stepSeconds = 1.0 / hz; }
+
+private:
+	double stepSeconds;
+	double accumulator = 0.0;
+	int maxSteps;
+};
+
+class SimulationThread
+{
+public:
+	explicit SimulationThread(std::function<void(int steps)> stepFunction);
+	~SimulationThread();
+
+	void start(int steps);
+	void wait();
+
+private:
+	std::function<void(int)> stepFunction;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	int pending = 0;
+	bool busy = false;
+	bool stopping = false;
+
+	void loop();
+};
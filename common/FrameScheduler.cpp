@@ -0,0 +1,59 @@
+#include "FrameScheduler.h"
+
+#include <limits>
+
+static const double NEVER = std::numeric_limits<double>::infinity();
+
+static void refreshCallback(GLFWwindow* window) {
+	FrameScheduler::of(window)->invalidate();
+}
+
+static void resizeCallback(GLFWwindow* window, int width, int height) {
+	FrameScheduler::of(window)->invalidate();
+}
+
+FrameScheduler::FrameScheduler(GLFWwindow* window) : window(window), redraw(true), wakeTime(NEVER) {
+	glfwSetWindowUserPointer(window, this);
+	glfwSetWindowRefreshCallback(window, refreshCallback);
+	glfwSetFramebufferSizeCallback(window, resizeCallback);
+}
+
+FrameScheduler* FrameScheduler::of(GLFWwindow* window) {
+	return (FrameScheduler*)glfwGetWindowUserPointer(window);
+}
+
+void FrameScheduler::invalidateFromThread() {
+	redraw = true;
+	glfwPostEmptyEvent();
+}
+
+void FrameScheduler::animateUntil(double time) {
+	if (time > animationEnd) animationEnd = time;
+}
+
+void FrameScheduler::wakeAt(double time) {
+	if (time < wakeTime) wakeTime = time;
+}
+
+bool FrameScheduler::waitForFrame() {
+	glfwPollEvents();
+	for (;;) {
+		if (glfwWindowShouldClose(window)) return false;
+
+		double now = glfwGetTime();
+		bool due = redraw.exchange(false) || continuous || now < animationEnd;
+		if (now >= wakeTime) {
+			wakeTime = NEVER;
+			due = true;
+		}
+		if (due) {
+			drawn++;
+			return true;
+		}
+
+		// nothing to draw: sleep until an event (callbacks may invalidate) or the next deadline
+		waits++;
+		if (wakeTime < NEVER) glfwWaitEventsTimeout(wakeTime - now);
+		else glfwWaitEvents();
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <glfw3.h>
+
+#include <atomic>
+/*
+	Render on demand: the loop sleeps in glfwWaitEvents while the picture cannot change,
+		HOW TO USE IT:
+	* create it after the window: FrameScheduler frames(window); it takes the window user pointer
+	  and the refresh / framebuffer size callbacks (exposed or resized window = redraw)
+	* the loop becomes: while (frames.waitForFrame()) { draw; glfwSwapBuffers(window); }
+	  waitForFrame() handles the events and returns when a frame is due, false once the window
+	  should close; it replaces glfwPollEvents
+	* input callbacks call invalidate() (FrameScheduler::of(window) when only the window is at
+	  hand); a worker finishing a resource load calls invalidateFromThread(), which also wakes
+	  the waiting main thread with glfwPostEmptyEvent
+	* animations: animateUntil(time) draws every frame until then, setContinuous(true) until
+	  switched off, wakeAt(time) asks for one frame at the next deadline (timers, debounce) and
+	  sleeps until then with glfwWaitEventsTimeout
+	* idle, the thread blocks in the OS event wait: no frames, no swaps, ~0% CPU and GPU
+*/
+class FrameScheduler
+{
+public:
+	explicit FrameScheduler(GLFWwindow* window);
+
+	static FrameScheduler* of(GLFWwindow* window);
+
+	void invalidate() { redraw = true; }
+	void invalidateFromThread();
+	void animateUntil(double time);
+	void setContinuous(bool on) { continuous = on; }
+	void wakeAt(double time);
+
+	bool waitForFrame();
+
+	long framesDrawn() const { return drawn; }
+	long idleWaits() const { return waits; }
+
+private:
+	GLFWwindow* window;
+	std::atomic<bool> redraw;
+	bool continuous = false;
+	double animationEnd = 0.0;
+	double wakeTime;
+	long drawn = 0, waits = 0;
+};
@@ -0,0 +1,14 @@
+#include "ImageUtils.h"
+
+#include <cstring>
+
+void padRGBA8(const unsigned char* src, int srcWidth, int srcHeight,
+	unsigned char* dst, int dstWidth, int dstHeight) {
+	for (int y = 0; y < dstHeight; y++) {
+		const unsigned char* row = src + (size_t)(y < srcHeight ? y : srcHeight - 1) * srcWidth * 4;
+		unsigned char* out = dst + (size_t)y * dstWidth * 4;
+		memcpy(out, row, (size_t)srcWidth * 4);
+		for (int x = srcWidth; x < dstWidth; x++)
+			memcpy(out + (size_t)x * 4, row + (size_t)(srcWidth - 1) * 4, 4);
+	}
+}
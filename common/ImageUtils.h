@@ -0,0 +1,9 @@
+#pragma once
+/*
+	CPU-side image helpers used by the texture loader (run on worker threads, no GL calls)
+*/
+
+// the image at texel (0, 0) of a larger dst, the rest repeats its last column / row so filtering
+// and mips at the edge see no foreign color; sample it with uv * (srcWidth / dstWidth, srcHeight / dstHeight)
+void padRGBA8(const unsigned char* src, int srcWidth, int srcHeight,
+	unsigned char* dst, int dstWidth, int dstHeight);
@@ -0,0 +1,251 @@
+#include "Ktx2.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "MipGenerator.h"
+
+static const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// header (after the identifier) + index, see the KTX2 specification, section 3
+static const size_t HEADER_BYTES = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+static const size_t LEVEL_INDEX_BYTES = 3 * 8;
+
+uint32_t ktx2BlockBytes(uint32_t vkFormat) {
+	switch (vkFormat) {
+	case KTX2_VK_FORMAT_R8G8B8_UNORM: return 3;
+	case KTX2_VK_FORMAT_R8G8B8A8_UNORM: return 4;
+	case KTX2_VK_FORMAT_BC1_RGB_UNORM: return 8;
+	case KTX2_VK_FORMAT_BC3_UNORM: return 16;
+	default: return 0;
+	}
+}
+
+bool ktx2IsCompressed(uint32_t vkFormat) {
+	return vkFormat == KTX2_VK_FORMAT_BC1_RGB_UNORM || vkFormat == KTX2_VK_FORMAT_BC3_UNORM;
+}
+
+// mip padding is lcm(texel block size, 4)
+static uint32_t levelAlignment(uint32_t vkFormat) {
+	uint32_t bytes = ktx2BlockBytes(vkFormat);
+	return bytes % 4 == 0 ? bytes : bytes * 4;
+}
+
+static void put32(std::vector<unsigned char>& out, uint32_t value) {
+	for (int i = 0; i < 4; i++) out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+static void put64(std::vector<unsigned char>& out, uint64_t value) {
+	for (int i = 0; i < 8; i++) out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+static uint32_t get32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const unsigned char* p) {
+	return get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+// basic data format descriptor (Khronos Data Format spec, sections 5 and 10)
+static std::vector<unsigned char> makeDfd(uint32_t vkFormat) {
+	if (!ktx2IsCompressed(vkFormat)) {
+		// RGBSDA model, one 8-bit sample per channel
+		uint32_t channels = ktx2BlockBytes(vkFormat);
+		uint32_t blockSize = 24 + 16 * channels;
+		std::vector<unsigned char> dfd;
+		put32(dfd, 4 + blockSize);
+		put32(dfd, 0);
+		put32(dfd, 2 | (blockSize << 16));
+		put32(dfd, 1 | (1 << 8) | (1 << 16));
+		put32(dfd, 0);							// 1x1 texel block
+		put32(dfd, channels);
+		put32(dfd, 0);
+		for (uint32_t c = 0; c < channels; c++) {
+			uint32_t channelId = c == 3 ? 15 : c;	// R, G, B, alpha
+			put32(dfd, (8 * c) | (7 << 16) | (channelId << 24));
+			put32(dfd, 0);
+			put32(dfd, 0);
+			put32(dfd, 255);
+		}
+		return dfd;
+	}
+
+	bool bc3 = vkFormat == KTX2_VK_FORMAT_BC3_UNORM;
+	uint32_t samples = bc3 ? 2 : 1;
+	uint32_t blockSize = 24 + 16 * samples;
+
+	std::vector<unsigned char> dfd;
+	put32(dfd, 4 + blockSize);
+	put32(dfd, 0);							// vendor Khronos, basic descriptor type
+	put32(dfd, 2 | (blockSize << 16));		// version 1.3, block size
+	put32(dfd, (bc3 ? 130 : 128) | (1 << 8) | (1 << 16));	// BC3/BC1A model, BT.709 primaries, linear
+	put32(dfd, 3 | (3 << 8));				// 4x4 texel block
+	put32(dfd, bc3 ? 16 : 8);				// bytes in plane 0
+	put32(dfd, 0);
+
+	if (bc3) {
+		put32(dfd, 0 | (63 << 16) | (15u << 24));	// alpha block, bits 0..63
+		put32(dfd, 0);
+		put32(dfd, 0);
+		put32(dfd, 0xFFFFFFFF);
+	}
+	put32(dfd, (bc3 ? 64 : 0) | (63 << 16));		// color block
+	put32(dfd, 0);
+	put32(dfd, 0);
+	put32(dfd, 0xFFFFFFFF);
+	return dfd;
+}
+
+// key/value data, sorted by key (std::map order), each entry padded to 4 bytes
+static std::vector<unsigned char> makeKvd(const std::map<std::string, std::string>& metadata) {
+	std::vector<unsigned char> kvd;
+	for (const std::pair<const std::string, std::string>& entry : metadata) {
+		put32(kvd, (uint32_t)(entry.first.size() + 1 + entry.second.size() + 1));
+		kvd.insert(kvd.end(), entry.first.begin(), entry.first.end());
+		kvd.push_back(0);
+		kvd.insert(kvd.end(), entry.second.begin(), entry.second.end());
+		kvd.push_back(0);
+		kvd.resize((kvd.size() + 3) / 4 * 4, 0);
+	}
+	return kvd;
+}
+
+static bool readKvd(const unsigned char* kvd, size_t size, std::map<std::string, std::string>& metadata) {
+	size_t at = 0;
+	while (at + 4 <= size) {
+		size_t length = get32(kvd + at);
+		at += 4;
+		if (length > size - at) return false;
+		const char* entry = (const char*)kvd + at;
+		size_t keyLength = strnlen(entry, length);
+		if (keyLength == length) return false;
+		// values written here end with a NUL, other writers may leave it out
+		size_t valueLength = length - keyLength - 1;
+		if (valueLength > 0 && entry[length - 1] == 0) valueLength--;
+		metadata[std::string(entry, keyLength)] = std::string(entry + keyLength + 1, valueLength);
+		at = (at + length + 3) / 4 * 4;
+	}
+	return true;
+}
+
+bool writeKtx2(const std::string& path, const Ktx2Image& image) {
+	uint32_t alignment = levelAlignment(image.vkFormat);
+	if (alignment == 0 || image.levels.empty()) return false;
+
+	size_t levelCount = image.levels.size();
+	std::vector<unsigned char> dfd = makeDfd(image.vkFormat);
+	std::vector<unsigned char> kvd = makeKvd(image.metadata);
+	size_t dfdOffset = HEADER_BYTES + LEVEL_INDEX_BYTES * levelCount;
+	size_t kvdOffset = dfdOffset + dfd.size();
+
+	// level data goes smallest mip first, each level aligned to the mip padding
+	std::vector<uint64_t> offsets(levelCount);
+	uint64_t offset = kvdOffset + kvd.size();
+	for (size_t i = levelCount; i-- > 0;) {
+		offset = (offset + alignment - 1) / alignment * alignment;
+		offsets[i] = offset;
+		offset += image.levels[i].size();
+	}
+
+	std::vector<unsigned char> out(KTX2_IDENTIFIER, KTX2_IDENTIFIER + 12);
+	put32(out, image.vkFormat);
+	put32(out, 1);					// typeSize
+	put32(out, image.width);
+	put32(out, image.height);
+	put32(out, 0);					// pixelDepth
+	put32(out, image.layers);
+	put32(out, 1);					// faceCount
+	put32(out, (uint32_t)levelCount);
+	put32(out, 0);					// supercompressionScheme
+	put32(out, (uint32_t)dfdOffset);
+	put32(out, (uint32_t)dfd.size());
+	put32(out, kvd.empty() ? 0 : (uint32_t)kvdOffset);
+	put32(out, (uint32_t)kvd.size());
+	put64(out, 0);					// no supercompression global data
+	put64(out, 0);
+	for (size_t i = 0; i < levelCount; i++) {
+		put64(out, offsets[i]);
+		put64(out, image.levels[i].size());
+		put64(out, image.levels[i].size());
+	}
+	out.insert(out.end(), dfd.begin(), dfd.end());
+	out.insert(out.end(), kvd.begin(), kvd.end());
+
+	for (size_t i = levelCount; i-- > 0;) {
+		out.resize((size_t)offsets[i], 0);
+		out.insert(out.end(), image.levels[i].begin(), image.levels[i].end());
+	}
+
+	// every writer gets its own temporary name, the complete file replaces path in one rename
+	static std::atomic<unsigned> writeCounter(0);
+	std::string temporary = path + "." + std::to_string(writeCounter++) + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		if (!file.is_open()) return false;
+		file.write((const char*)out.data(), out.size());
+		if (!file.good()) {
+			file.close();
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+	if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+		// rename does not replace an existing file on Windows
+		std::remove(path.c_str());
+		if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+bool readKtx2(const std::string& path, Ktx2Image& image) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (data.size() < HEADER_BYTES || memcmp(data.data(), KTX2_IDENTIFIER, 12) != 0)
+		return false;
+
+	const unsigned char* header = data.data() + 12;
+	image.vkFormat = get32(header);
+	image.width = get32(header + 8);
+	image.height = get32(header + 12);
+	image.layers = get32(header + 20);
+	uint32_t depth = get32(header + 16), faces = get32(header + 24);
+	uint32_t levelCount = get32(header + 28);
+	uint32_t supercompression = get32(header + 32);
+	uint32_t blockBytes = ktx2BlockBytes(image.vkFormat);
+	if (blockBytes == 0 || supercompression != 0 || depth != 0 || faces != 1)
+		return false;
+	if (image.width == 0 || image.height == 0 || levelCount == 0
+		|| levelCount > (uint32_t)mipLevelCount(image.width, image.height))
+		return false;
+	if (data.size() < HEADER_BYTES + LEVEL_INDEX_BYTES * levelCount)
+		return false;
+
+	uint32_t kvdOffset = get32(header + 44), kvdLength = get32(header + 48);
+	image.metadata.clear();
+	if ((uint64_t)kvdOffset + kvdLength > data.size() || !readKvd(data.data() + kvdOffset, kvdLength, image.metadata))
+		return false;
+
+	image.levels.assign(levelCount, std::vector<unsigned char>());
+	for (uint32_t i = 0; i < levelCount; i++) {
+		const unsigned char* entry = data.data() + HEADER_BYTES + LEVEL_INDEX_BYTES * i;
+		uint64_t offset = get64(entry);
+		uint64_t length = get64(entry + 8);
+
+		// the level must hold exactly what the upload will read, anything else falls back to decoding
+		uint64_t w = image.width >> i > 0 ? image.width >> i : 1;
+		uint64_t h = image.height >> i > 0 ? image.height >> i : 1;
+		uint64_t expected = ktx2IsCompressed(image.vkFormat) ? ((w + 3) / 4) * ((h + 3) / 4) * blockBytes : w * h * blockBytes;
+		expected *= image.layers > 0 ? image.layers : 1;
+		if (length != expected || offset > data.size() || length > data.size() - offset) return false;
+		image.levels[i].assign(data.begin() + (size_t)offset, data.begin() + (size_t)(offset + length));
+	}
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+/*
+	Minimal KTX2 container for the texture cache (no supercompression),
+	* holds either BC1/BC3 blocks or plain RGB8/RGBA8 levels with a prebuilt mip chain
+	* levels[0] is the full-size image, every level holds all array layers one after another
+	* layers == 0 means a plain 2D texture, like in the KTX2 header
+	* metadata is the key/value data, string values only
+	* writeKtx2 writes a temporary file next to path and renames it over path, an interrupted
+	  or concurrent write never leaves a truncated file under the real name
+*/
+
+// Vulkan format numbers used in the vkFormat field
+const uint32_t KTX2_VK_FORMAT_R8G8B8_UNORM = 23;
+const uint32_t KTX2_VK_FORMAT_R8G8B8A8_UNORM = 37;
+const uint32_t KTX2_VK_FORMAT_BC1_RGB_UNORM = 131;
+const uint32_t KTX2_VK_FORMAT_BC3_UNORM = 137;
+
+// metadata of arrays whose layers were padded instead of resized: "width height" of every
+// layer's image, the rest of the layer repeats its edge (padRGBA8)
+const char* const KTX2_KEY_LAYER_SIZES = "GKlayerSizes";
+
+struct Ktx2Image
+{
+	uint32_t vkFormat = 0;
+	uint32_t width = 0, height = 0;
+	uint32_t layers = 0;
+	std::vector<std::vector<unsigned char>> levels;
+	std::map<std::string, std::string> metadata;
+};
+
+bool writeKtx2(const std::string& path, const Ktx2Image& image);
+bool readKtx2(const std::string& path, Ktx2Image& image);
+
+// bytes per 4x4 block (BC formats) or per texel (8-bit formats), 0 for anything else
+uint32_t ktx2BlockBytes(uint32_t vkFormat);
+bool ktx2IsCompressed(uint32_t vkFormat);
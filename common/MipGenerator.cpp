@@ -0,0 +1,200 @@
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_SSE2 1
+#endif
+
+namespace {
+	struct SrgbTables
+	{
+		float toLinear[256];
+		unsigned char toSrgb[4096];
+
+		SrgbTables() {
+			for (int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (int i = 0; i < 4096; i++) {
+				float l = i / 4095.0f;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				toSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+			}
+		}
+	};
+
+	const SrgbTables& srgbTables() {
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	void downsampleRowScalar(const unsigned char* row0, const unsigned char* row1, int width, int channels,
+		unsigned char* dst, int dstWidth, int from, bool srgb) {
+		const SrgbTables& t = srgbTables();
+		for (int x = from; x < dstWidth; x++) {
+			int x0 = 2 * x, x1 = 2 * x + 1 < width ? 2 * x + 1 : 2 * x;
+			for (int c = 0; c < channels; c++) {
+				unsigned char a = row0[x0 * channels + c], b = row0[x1 * channels + c];
+				unsigned char d = row1[x0 * channels + c], e = row1[x1 * channels + c];
+				bool color = srgb && (c < 3) && !(channels == 2 && c == 1);
+				if (color) {
+					float l = (t.toLinear[a] + t.toLinear[b] + t.toLinear[d] + t.toLinear[e]) * 0.25f;
+					dst[x * channels + c] = t.toSrgb[(int)(l * 4095.0f + 0.5f)];
+				}
+				else {
+					dst[x * channels + c] = (unsigned char)((a + b + d + e + 2) >> 2);
+				}
+			}
+		}
+	}
+
+#ifdef MIP_SSE2
+	// RGBA8, linear: 2 output texels per iteration, exact (a+b+c+d+2)/4 in 16-bit lanes
+	int downsampleRowSSE2(const unsigned char* row0, const unsigned char* row1, int width,
+		unsigned char* dst, int dstWidth) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		int x = 0;
+		for (; x + 2 <= dstWidth && 2 * x + 4 <= width; x += 2) {
+			__m128i top = _mm_loadu_si128((const __m128i*)(row0 + 8 * x));
+			__m128i bottom = _mm_loadu_si128((const __m128i*)(row1 + 8 * x));
+			__m128i sumLo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+			__m128i sumHi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+			// lanes: [p0 p1] in sumLo, [p2 p3] in sumHi -> add the neighbouring texels
+			__m128i pairLo = _mm_add_epi16(sumLo, _mm_srli_si128(sumLo, 8));
+			__m128i pairHi = _mm_add_epi16(sumHi, _mm_srli_si128(sumHi, 8));
+			__m128i sums = _mm_unpacklo_epi64(pairLo, pairHi);
+			sums = _mm_srli_epi16(_mm_add_epi16(sums, two), 2);
+			_mm_storel_epi64((__m128i*)(dst + 4 * x), _mm_packus_epi16(sums, zero));
+		}
+		return x;
+	}
+
+	// RGB8, linear: 1 output texel per iteration from 8-byte loads, same exact rounding
+	int downsampleRowRgbSSE2(const unsigned char* row0, const unsigned char* row1, int width,
+		unsigned char* dst, int dstWidth) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i two = _mm_set1_epi16(2);
+		int x = 0;
+		for (; x < dstWidth && 6 * x + 8 <= 3 * width; x++) {
+			__m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row0 + 6 * x)), zero);
+			__m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(row1 + 6 * x)), zero);
+			// lanes 0-2 the left texel, 3-5 the right one
+			__m128i sum = _mm_add_epi16(top, bottom);
+			sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 6));
+			sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+			int texel = _mm_cvtsi128_si32(_mm_packus_epi16(sum, zero));
+			memcpy(dst + 3 * x, &texel, 3);
+		}
+		return x;
+	}
+
+	// sRGB, 3 or 4 channels: 1 output texel per iteration, the color channels go to linear light
+	// through the table and are averaged and scaled in one float vector (the same operations and
+	// rounding as the scalar loop, so both give the same bytes), alpha is averaged exactly
+	int downsampleRowSrgbSSE2(const unsigned char* row0, const unsigned char* row1, int width, int channels,
+		unsigned char* dst, int dstWidth) {
+		const SrgbTables& t = srgbTables();
+		const float* L = t.toLinear;
+		const __m128 quarter = _mm_set1_ps(0.25f), scale = _mm_set1_ps(4095.0f), half = _mm_set1_ps(0.5f);
+		int x = 0;
+		for (; x < dstWidth && 2 * x + 1 < width; x++) {
+			const unsigned char* a = row0 + 2 * x * channels;
+			const unsigned char* b = a + channels;
+			const unsigned char* d = row1 + 2 * x * channels;
+			const unsigned char* e = d + channels;
+			__m128 sum = _mm_setr_ps(L[a[0]], L[a[1]], L[a[2]], 0.0f);
+			sum = _mm_add_ps(sum, _mm_setr_ps(L[b[0]], L[b[1]], L[b[2]], 0.0f));
+			sum = _mm_add_ps(sum, _mm_setr_ps(L[d[0]], L[d[1]], L[d[2]], 0.0f));
+			sum = _mm_add_ps(sum, _mm_setr_ps(L[e[0]], L[e[1]], L[e[2]], 0.0f));
+			__m128 level = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sum, quarter), scale), half);
+			__m128i index = _mm_cvttps_epi32(level);
+
+			unsigned char* out = dst + x * channels;
+			out[0] = t.toSrgb[_mm_cvtsi128_si32(index)];
+			out[1] = t.toSrgb[_mm_cvtsi128_si32(_mm_srli_si128(index, 4))];
+			out[2] = t.toSrgb[_mm_cvtsi128_si32(_mm_srli_si128(index, 8))];
+			if (channels == 4)
+				out[3] = (unsigned char)((a[3] + b[3] + d[3] + e[3] + 2) >> 2);
+		}
+		return x;
+	}
+#endif
+}
+
+int mipLevelCount(int width, int height) {
+	int size = width > height ? width : height;
+	int levels = 1;
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+void downsample(const unsigned char* src, int width, int height, int channels,
+	unsigned char* dst, bool srgb) {
+	int dstWidth = width > 1 ? width / 2 : 1;
+	int dstHeight = height > 1 ? height / 2 : 1;
+	size_t stride = (size_t)width * channels;
+
+	for (int y = 0; y < dstHeight; y++) {
+		const unsigned char* row0 = src + (size_t)(2 * y) * stride;
+		const unsigned char* row1 = 2 * y + 1 < height ? row0 + stride : row0;
+		unsigned char* out = dst + (size_t)y * dstWidth * channels;
+
+		int done = 0;
+#ifdef MIP_SSE2
+		if ((channels == 3 || channels == 4) && srgb)
+			done = downsampleRowSrgbSSE2(row0, row1, width, channels, out, dstWidth);
+		else if (channels == 4)
+			done = downsampleRowSSE2(row0, row1, width, out, dstWidth);
+		else if (channels == 3)
+			done = downsampleRowRgbSSE2(row0, row1, width, out, dstWidth);
+#endif
+		downsampleRowScalar(row0, row1, width, channels, out, dstWidth, done, srgb);
+	}
+}
+
+static float alphaCoverage(const std::vector<unsigned char>& level, int channels, float cutoff, float scale) {
+	size_t texels = level.size() / channels, passed = 0;
+	for (size_t i = 0; i < texels; i++)
+		if (level[i * channels + channels - 1] * scale >= cutoff * 255.0f) passed++;
+	return texels ? (float)passed / texels : 0.0f;
+}
+
+void buildMipChain(std::vector<std::vector<unsigned char>>& levels, int width, int height,
+	int channels, const MipOptions& options) {
+	levels.resize(1);
+	bool hasAlpha = channels == 2 || channels == 4;
+	float coverage = hasAlpha && options.alphaCutoff > 0.0f
+		? alphaCoverage(levels[0], channels, options.alphaCutoff, 1.0f) : 0.0f;
+
+	int w = width, h = height;
+	while (w > 1 || h > 1) {
+		int nw = w > 1 ? w / 2 : 1, nh = h > 1 ? h / 2 : 1;
+		levels.push_back(std::vector<unsigned char>((size_t)nw * nh * channels));
+		downsample(levels[levels.size() - 2].data(), w, h, channels, levels.back().data(), options.srgb);
+
+		if (hasAlpha && options.alphaCutoff > 0.0f) {
+			// binary search for the alpha scale that restores level 0 coverage
+			std::vector<unsigned char>& level = levels.back();
+			float lo = 0.0f, hi = 4.0f;
+			for (int it = 0; it < 10; it++) {
+				float mid = 0.5f * (lo + hi);
+				if (alphaCoverage(level, channels, options.alphaCutoff, mid) < coverage) lo = mid;
+				else hi = mid;
+			}
+			for (size_t i = channels - 1; i < level.size(); i += channels) {
+				float a = level[i] * hi;
+				level[i] = (unsigned char)(a > 255.0f ? 255.0f : a + 0.5f);
+			}
+		}
+		w = nw;
+		h = nh;
+	}
+}
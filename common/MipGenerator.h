@@ -0,0 +1,28 @@
+#pragma once
+#include <vector>
+/*
+	CPU mip chain generation (2x2 box filter), used on the loader's worker threads
+	instead of glGenerateMipmap on the GL thread,
+	* srgb: color channels are averaged in linear light and stored back as sRGB
+	* alphaCutoff > 0: every level's alpha is rescaled so the fraction of texels passing the
+	  alpha test (alpha >= cutoff) matches level 0, cut-out foliage/fences do not thin out
+	* 3- and 4-channel images take an SSE2 path: sRGB color channels are averaged in linear light
+	  in float vectors (table in, table out, the same bytes as the scalar loop), linear ones with
+	  exact integer rounding
+*/
+struct MipOptions
+{
+	bool srgb = true;
+	float alphaCutoff = 0.0f;
+};
+
+// one level down to floor(size / 2) like GL mip sizes: each texel is the 2x2 box of texels
+// 2x..2x+1, so an odd size drops its last column / row; a size of 1 stays 1 and reuses that row / column
+void downsample(const unsigned char* src, int width, int height, int channels,
+	unsigned char* dst, bool srgb);
+
+// appends level 1..n (down to 1x1) after level 0, levels[0] must already hold the image
+void buildMipChain(std::vector<std::vector<unsigned char>>& levels, int width, int height,
+	int channels, const MipOptions& options);
+
+int mipLevelCount(int width, int height);
@@ -0,0 +1,343 @@
+#include "ParticleSystem.h"
+
+#include "ThreadPool.h"
+#include "Xorshift.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PARTICLE_SSE2 1
+#endif
+
+// integer hash of body and frame, a random color without RNG state shared between threads
+static unsigned hashColor(unsigned index, unsigned frame) {
+	unsigned h = index * 0x9E3779B1u ^ frame * 0x85EBCA77u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	h *= 0x297A2D39u;
+	h ^= h >> 15;
+	return h | 0xFF000000u;
+}
+
+// earliest contact of the moving circle with one feature, time in [0, limit)
+struct Impact
+{
+	float time;
+	float nx = 0.0f, ny = 0.0f;	// unit normal out of the surface, 0 = nothing hit
+
+	void face(float t, float normalX, float normalY) {
+		if (t < 0.0f) t = 0.0f;
+		if (t >= time) return;
+		time = t;
+		nx = normalX;
+		ny = normalY;
+	}
+
+	// rounded corner of an obstacle: |p + v t - c| = r
+	void corner(float px, float py, float vx, float vy, float r, float cx, float cy) {
+		float dx = px - cx, dy = py - cy;
+		float b = dx * vx + dy * vy;
+		if (b >= 0.0f) return;	// moving away
+		float a = vx * vx + vy * vy;
+		float c = dx * dx + dy * dy - r * r;
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f) return;
+		float t = (-b - std::sqrt(discriminant)) / a;
+		if (t < 0.0f) t = 0.0f;
+		if (t >= time) return;
+		time = t;
+		nx = (dx + vx * t) / r;
+		ny = (dy + vy * t) / r;
+	}
+};
+
+static const float CONTACT_EPSILON = 1e-4f;
+
+// the circle grown rect is four faces and four corner circles, the earliest one hit wins
+static void sweepObstacle(Impact& impact, float px, float py, float vx, float vy, float r, const Obstacle& o) {
+	if (vx > 0.0f && px <= o.left - r + CONTACT_EPSILON) {
+		float t = (o.left - r - px) / vx, hy = py + vy * t;
+		if (hy >= o.top && hy <= o.bottom) impact.face(t, -1.0f, 0.0f);
+	}
+	if (vx < 0.0f && px >= o.right + r - CONTACT_EPSILON) {
+		float t = (o.right + r - px) / vx, hy = py + vy * t;
+		if (hy >= o.top && hy <= o.bottom) impact.face(t, 1.0f, 0.0f);
+	}
+	if (vy > 0.0f && py <= o.top - r + CONTACT_EPSILON) {
+		float t = (o.top - r - py) / vy, hx = px + vx * t;
+		if (hx >= o.left && hx <= o.right) impact.face(t, 0.0f, -1.0f);
+	}
+	if (vy < 0.0f && py >= o.bottom + r - CONTACT_EPSILON) {
+		float t = (o.bottom + r - py) / vy, hx = px + vx * t;
+		if (hx >= o.left && hx <= o.right) impact.face(t, 0.0f, 1.0f);
+	}
+	impact.corner(px, py, vx, vy, r, o.left, o.top);
+	impact.corner(px, py, vx, vy, r, o.right, o.top);
+	impact.corner(px, py, vx, vy, r, o.left, o.bottom);
+	impact.corner(px, py, vx, vy, r, o.right, o.bottom);
+}
+
+// a body already overlapping the obstacle (pushed in by a collision, spawned inside) is moved
+// out the shortest way and its velocity reflected if it still points inwards
+static bool pushOut(float& px, float& py, float& vx, float& vy, float r, const Obstacle& o) {
+	float qx = px < o.left ? o.left : (px > o.right ? o.right : px);
+	float qy = py < o.top ? o.top : (py > o.bottom ? o.bottom : py);
+	float dx = px - qx, dy = py - qy;
+	float distance2 = dx * dx + dy * dy;
+	if (distance2 >= r * r) return false;
+
+	float nx, ny;
+	if (distance2 > 0.0f) {
+		float distance = std::sqrt(distance2);
+		nx = dx / distance;
+		ny = dy / distance;
+	}
+	else {
+		// centre inside the rect: out through the nearest side
+		float toLeft = px - o.left, toRight = o.right - px, toTop = py - o.top, toBottom = o.bottom - py;
+		float nearest = std::fmin(std::fmin(toLeft, toRight), std::fmin(toTop, toBottom));
+		nx = nearest == toLeft ? -1.0f : (nearest == toRight ? 1.0f : 0.0f);
+		ny = nx != 0.0f ? 0.0f : (nearest == toTop ? -1.0f : 1.0f);
+		qx = nx < 0.0f ? o.left : (nx > 0.0f ? o.right : px);
+		qy = ny < 0.0f ? o.top : (ny > 0.0f ? o.bottom : py);
+	}
+	px = qx + nx * r;
+	py = qy + ny * r;
+	float approach = vx * nx + vy * ny;
+	if (approach < 0.0f) {
+		vx -= 2.0f * approach * nx;
+		vy -= 2.0f * approach * ny;
+	}
+	return true;
+}
+
+static inline float clampToBounds(float position, float r, float limit) {
+	if (limit < 2.0f * r) return limit * 0.5f;
+	return position < r ? r : (position > limit - r ? limit - r : position);
+}
+
+ParticleSystem::ParticleSystem(float width, float height) : width(width), height(height) {
+}
+
+size_t ParticleSystem::add(float px, float py, float pvx, float pvy, float r, unsigned c) {
+	x.push_back(px);
+	y.push_back(py);
+	prevX.push_back(px);
+	prevY.push_back(py);
+	vx.push_back(pvx);
+	vy.push_back(pvy);
+	radius.push_back(r);
+	color.push_back(c);
+	events.push_back(0);
+	return x.size() - 1;
+}
+
+void ParticleSystem::spawnRandom(size_t count, float minRadius, float maxRadius, float speed, unsigned seed) {
+	size_t total = size() + count;
+	x.reserve(total); y.reserve(total); vx.reserve(total); vy.reserve(total);
+	radius.reserve(total); color.reserve(total); events.reserve(total);
+	prevX.reserve(total); prevY.reserve(total);
+
+	// the same seed gives the same bodies
+	Xorshift random(seed);
+
+	for (size_t i = 0; i < count; i++) {
+		float r = minRadius + (maxRadius - minRadius) * random.next();
+		float px = r + (width - 2.0f * r) * random.next();
+		float py = r + (height - 2.0f * r) * random.next();
+		float angle = 6.2831853f * random.next();
+		add(px, py, speed * std::cos(angle), speed * std::sin(angle), r, hashColor((unsigned)size(), seed));
+	}
+}
+
+void ParticleSystem::clear() {
+	x.clear(); y.clear(); vx.clear(); vy.clear();
+	radius.clear(); color.clear(); events.clear();
+	prevX.clear(); prevY.clear();
+}
+
+void ParticleSystem::clearEvents() {
+	std::fill(events.begin(), events.end(), (unsigned char)0);
+}
+
+size_t ParticleSystem::countEvents(unsigned mask) const {
+	size_t count = 0;
+	for (unsigned char event : events)
+		count += (event & mask) != 0;
+	return count;
+}
+
+void ParticleSystem::addObstacle(float left, float top, float right, float bottom) {
+	obstacles.push_back({ left, top, right, bottom });
+}
+
+void ParticleSystem::step(float dt, BallInstance* instances, ThreadPool* pool) {
+	size_t count = size();
+	if (pool && count > STEP_BLOCK) {
+		// block boundaries are multiples of 4, every chunk runs the SIMD loop from its start
+		size_t blocks = (count + STEP_BLOCK - 1) / STEP_BLOCK;
+		pool->parallelFor(blocks, [&](size_t first, size_t last) {
+			size_t end = last * STEP_BLOCK < count ? last * STEP_BLOCK : count;
+			stepRange(first * STEP_BLOCK, end, dt, instances);
+		});
+	}
+	else if (count) {
+		stepRange(0, count, dt, instances);
+	}
+	frame++;
+}
+
+void ParticleSystem::writeInstances(float alpha, BallInstance* instances, ThreadPool* pool) const {
+	size_t count = size();
+	if (pool && count > STEP_BLOCK) {
+		size_t blocks = (count + STEP_BLOCK - 1) / STEP_BLOCK;
+		pool->parallelFor(blocks, [&](size_t first, size_t last) {
+			size_t end = last * STEP_BLOCK < count ? last * STEP_BLOCK : count;
+			interpolateRange(first * STEP_BLOCK, end, alpha, instances);
+		});
+	}
+	else if (count) {
+		interpolateRange(0, count, alpha, instances);
+	}
+}
+
+void ParticleSystem::stepRange(size_t begin, size_t end, float dt, BallInstance* instances) {
+	size_t i = begin;
+
+#ifdef PARTICLE_SSE2
+	const __m128 step = _mm_set1_ps(dt);
+	const __m128 right = _mm_set1_ps(width), bottom = _mm_set1_ps(height);
+	for (; i + 4 <= end; i += 4) {
+		__m128 fromX = _mm_loadu_ps(&x[i]), fromY = _mm_loadu_ps(&y[i]);
+		__m128 r = _mm_loadu_ps(&radius[i]);
+		_mm_storeu_ps(&prevX[i], fromX);
+		_mm_storeu_ps(&prevY[i], fromY);
+
+		__m128 px = _mm_add_ps(fromX, _mm_mul_ps(_mm_loadu_ps(&vx[i]), step));
+		__m128 py = _mm_add_ps(fromY, _mm_mul_ps(_mm_loadu_ps(&vy[i]), step));
+		_mm_storeu_ps(&x[i], px);
+		_mm_storeu_ps(&y[i], py);
+
+		// outside [r, limit - r] at the end of the step: the sweep finds where and when
+		__m128 slow = _mm_or_ps(_mm_cmplt_ps(px, r), _mm_cmpgt_ps(px, _mm_sub_ps(right, r)));
+		slow = _mm_or_ps(slow, _mm_or_ps(_mm_cmplt_ps(py, r), _mm_cmpgt_ps(py, _mm_sub_ps(bottom, r))));
+
+		// the box swept by the circle against each obstacle
+		if (!obstacles.empty()) {
+			__m128 minX = _mm_sub_ps(_mm_min_ps(fromX, px), r), maxX = _mm_add_ps(_mm_max_ps(fromX, px), r);
+			__m128 minY = _mm_sub_ps(_mm_min_ps(fromY, py), r), maxY = _mm_add_ps(_mm_max_ps(fromY, py), r);
+			for (const Obstacle& o : obstacles) {
+				__m128 touch = _mm_and_ps(_mm_cmple_ps(minX, _mm_set1_ps(o.right)), _mm_cmpge_ps(maxX, _mm_set1_ps(o.left)));
+				touch = _mm_and_ps(touch, _mm_and_ps(_mm_cmple_ps(minY, _mm_set1_ps(o.bottom)), _mm_cmpge_ps(maxY, _mm_set1_ps(o.top))));
+				slow = _mm_or_ps(slow, touch);
+			}
+		}
+
+		int swept = _mm_movemask_ps(slow);
+		if (swept) {
+			for (int k = 0; k < 4; k++)
+				if (swept & (1 << k)) sweep(i + k, dt);
+			px = _mm_loadu_ps(&x[i]);
+			py = _mm_loadu_ps(&y[i]);
+		}
+
+		if (!instances) continue;
+
+		// four SoA registers -> four { x, y, radius, color } records
+		__m128 c = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&color[i]));
+		_MM_TRANSPOSE4_PS(px, py, r, c);
+		_mm_storeu_ps((float*)&instances[i], px);
+		_mm_storeu_ps((float*)&instances[i + 1], py);
+		_mm_storeu_ps((float*)&instances[i + 2], r);
+		_mm_storeu_ps((float*)&instances[i + 3], c);
+	}
+#endif
+
+	for (; i < end; i++) {
+		prevX[i] = x[i];
+		prevY[i] = y[i];
+		sweep(i, dt);
+		if (!instances) continue;
+
+		BallInstance& instance = instances[i];
+		instance.x = x[i];
+		instance.y = y[i];
+		instance.radius = radius[i];
+		instance.color = color[i];
+	}
+}
+
+// body i from prevX / prevY over dt: advance to the earliest wall or obstacle contact, reflect
+// the velocity there and continue with the time left; a body still hitting after MAX_IMPACTS
+// contacts (wedged in a corner) drops the rest of the step
+void ParticleSystem::sweep(size_t i, float dt) {
+	float px = prevX[i], py = prevY[i], pvx = vx[i], pvy = vy[i], r = radius[i];
+	unsigned char event = 0;
+	for (const Obstacle& o : obstacles)
+		if (pushOut(px, py, pvx, pvy, r, o)) event |= EVENT_OBSTACLE;
+
+	float remaining = dt;
+	for (int impacts = 0; impacts < MAX_IMPACTS && remaining > 0.0f; impacts++) {
+		Impact impact;
+		impact.time = remaining;
+		if (pvx < 0.0f) impact.face((r - px) / pvx, 1.0f, 0.0f);
+		if (pvx > 0.0f) impact.face((width - r - px) / pvx, -1.0f, 0.0f);
+		if (pvy < 0.0f) impact.face((r - py) / pvy, 0.0f, 1.0f);
+		if (pvy > 0.0f) impact.face((height - r - py) / pvy, 0.0f, -1.0f);
+		float wallTime = impact.time;
+		for (const Obstacle& o : obstacles)
+			sweepObstacle(impact, px, py, pvx, pvy, r, o);
+
+		px += pvx * impact.time;
+		py += pvy * impact.time;
+		remaining -= impact.time;
+		if (impact.nx == 0.0f && impact.ny == 0.0f) break;
+
+		float approach = pvx * impact.nx + pvy * impact.ny;
+		if (approach < 0.0f) {
+			pvx -= 2.0f * approach * impact.nx;
+			pvy -= 2.0f * approach * impact.ny;
+		}
+		event |= impact.time < wallTime ? EVENT_OBSTACLE : EVENT_WALL;
+	}
+
+	x[i] = clampToBounds(px, r, width);
+	y[i] = clampToBounds(py, r, height);
+	vx[i] = pvx;
+	vy[i] = pvy;
+	if (event) {
+		color[i] = hashColor((unsigned)i, frame);
+		events[i] |= event;
+	}
+}
+
+void ParticleSystem::interpolateRange(size_t begin, size_t end, float alpha, BallInstance* instances) const {
+	size_t i = begin;
+
+#ifdef PARTICLE_SSE2
+	const __m128 t = _mm_set1_ps(alpha);
+	for (; i + 4 <= end; i += 4) {
+		__m128 fromX = _mm_loadu_ps(&prevX[i]), fromY = _mm_loadu_ps(&prevY[i]);
+		__m128 px = _mm_add_ps(fromX, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&x[i]), fromX), t));
+		__m128 py = _mm_add_ps(fromY, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&y[i]), fromY), t));
+		__m128 r = _mm_loadu_ps(&radius[i]);
+		__m128 c = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)&color[i]));
+		_MM_TRANSPOSE4_PS(px, py, r, c);
+		_mm_storeu_ps((float*)&instances[i], px);
+		_mm_storeu_ps((float*)&instances[i + 1], py);
+		_mm_storeu_ps((float*)&instances[i + 2], r);
+		_mm_storeu_ps((float*)&instances[i + 3], c);
+	}
+#endif
+
+	for (; i < end; i++) {
+		BallInstance& instance = instances[i];
+		instance.x = prevX[i] + (x[i] - prevX[i]) * alpha;
+		instance.y = prevY[i] + (y[i] - prevY[i]) * alpha;
+		instance.radius = radius[i];
+		instance.color = color[i];
+	}
+}
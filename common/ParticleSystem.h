@@ -0,0 +1,87 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "Color.h"
+
+class ThreadPool;
+/*
+	Many bouncing balls in structure-of-arrays form,
+		HOW TO USE IT:
+	* add() or spawnRandom() bodies, the arrays x, y, vx, vy, radius, color are public and
+	  index i is one body; color is packed RGBA8 (r in the lowest byte)
+	* step(dt, instances, pool) moves every body, bounces it off [0, width] x [0, height] and
+	  writes one BallInstance per body straight into instances (a mapped instance VBO or any
+	  array of size() records, nullptr = no output); a bounce gives the body a new random color
+	* addObstacle(left, top, right, bottom) adds a static rectangle the bodies bounce off; walls
+	  and obstacles are continuous: a body whose path over the step touches one is swept to the
+	  time of impact, reflected and moved on for the rest of the step (up to MAX_IMPACTS times),
+	  so a long step cannot carry it through a thin obstacle or past a wall
+	* the step only records what happened: a new color in color[] and a BodyEvent bit in
+	  events[] per body (wall, obstacle, ball contact from BallCollisions); the bits accumulate
+	  over steps until clearEvents(), so the render thread reads them once per frame together
+	  with the single instance write, whatever the number of collisions
+	* the positions before the last step are kept in prevX / prevY, writeInstances(alpha, ...)
+	  outputs prev + (current - prev) * alpha for rendering between two fixed steps
+	* the kernel handles 4 bodies per SSE2 instruction, with a pool the bodies are split into
+	  blocks of STEP_BLOCK and stepped on all cores (no GL calls, safe on the workers); only the
+	  bodies whose swept box reaches a wall or an obstacle leave the SIMD path for the sweep
+*/
+struct BallInstance
+{
+	float x, y;
+	float radius;
+	unsigned color;
+};
+
+enum BodyEvent : unsigned char
+{
+	EVENT_WALL = 1,
+	EVENT_OBSTACLE = 2,
+	EVENT_BALL = 4,
+};
+
+struct Obstacle
+{
+	float left, top, right, bottom;
+};
+
+class ParticleSystem
+{
+public:
+	static const size_t STEP_BLOCK = 4096;
+	static const int MAX_IMPACTS = 4;
+
+	ParticleSystem(float width, float height);
+
+	size_t add(float x, float y, float vx, float vy, float radius, unsigned color);
+	// uniform position inside the bounds, random direction with the given speed
+	void spawnRandom(size_t count, float minRadius, float maxRadius, float speed, unsigned seed);
+	void clear();
+	void clearEvents();
+	// bodies with any of the mask bits since the last clearEvents()
+	size_t countEvents(unsigned mask) const;
+	size_t size() const { return x.size(); }
+
+	void step(float dt, BallInstance* instances, ThreadPool* pool = nullptr);
+	void writeInstances(float alpha, BallInstance* instances, ThreadPool* pool = nullptr) const;
+	void setBounds(float width, float height) { this->width = width; this->height = height; }
+	float boundsWidth() const { return width; }
+	float boundsHeight() const { return height; }
+	void addObstacle(float left, float top, float right, float bottom);
+	const std::vector<Obstacle>& obstacleRects() const { return obstacles; }
+
+	std::vector<float> x, y, vx, vy, radius;
+	std::vector<unsigned> color;
+	std::vector<unsigned char> events;
+	std::vector<float> prevX, prevY;
+
+private:
+	float width, height;
+	unsigned frame = 0;
+	std::vector<Obstacle> obstacles;
+
+	void stepRange(size_t begin, size_t end, float dt, BallInstance* instances);
+	void sweep(size_t i, float dt);
+	void interpolateRange(size_t begin, size_t end, float alpha, BallInstance* instances) const;
+};
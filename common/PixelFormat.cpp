@@ -0,0 +1,96 @@
+#include "PixelFormat.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_SSE2 1
+#endif
+
+UploadFormat negotiateUploadFormat(int channels, bool expandToBGRA) {
+	UploadFormat upload;
+	switch (channels) {
+	case 1:
+		upload.internalFormat = GL_R8;
+		upload.format = GL_RED;
+		upload.bytesPerPixel = 1;
+		break;
+	case 2:
+		upload.internalFormat = GL_RG8;
+		upload.format = GL_RG;
+		upload.bytesPerPixel = 2;
+		break;
+	case 3:
+		upload.internalFormat = expandToBGRA ? GL_RGBA8 : GL_RGB8;
+		upload.format = GL_RGB;
+		upload.bytesPerPixel = 3;
+		break;
+	default:
+		break;
+	}
+
+	if (expandToBGRA && channels >= 3) {
+		upload.format = GL_BGRA;
+		upload.type = GL_UNSIGNED_INT_8_8_8_8_REV;
+		upload.bytesPerPixel = 4;
+		upload.expand = true;
+	}
+	return upload;
+}
+
+GLint unpackAlignment(size_t rowBytes) {
+	if (rowBytes % 8 == 0) return 8;
+	if (rowBytes % 4 == 0) return 4;
+	if (rowBytes % 2 == 0) return 2;
+	return 1;
+}
+
+void applyChannelSwizzle(GLenum target, int channels) {
+	if (channels == 1) {
+		const GLint grey[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, grey);
+	}
+	else if (channels == 2) {
+		const GLint greyAlpha[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, greyAlpha);
+	}
+}
+
+void expandToBGRA8(const unsigned char* src, int channels, size_t pixelCount, unsigned char* dst) {
+	size_t i = 0;
+#ifdef PIXEL_SSE2
+	const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+	const __m128i low = _mm_set1_epi32(0xFF);
+	const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+
+	if (channels == 4) {
+		for (; i + 4 <= pixelCount; i += 4) {
+			__m128i rgba = _mm_loadu_si128((const __m128i*)(src + i * 4));
+			__m128i bgra = _mm_or_si128(_mm_and_si128(rgba, greenAlpha),
+				_mm_or_si128(_mm_slli_epi32(_mm_and_si128(rgba, low), 16), _mm_and_si128(_mm_srli_epi32(rgba, 16), low)));
+			_mm_storeu_si128((__m128i*)(dst + i * 4), bgra);
+		}
+	}
+	else if (channels == 3) {
+		// four 4-byte loads at 3-byte steps, the byte after each pixel is replaced by alpha;
+		// the last pixel is left to the scalar loop so nothing past the source is read
+		for (; i + 5 <= pixelCount; i += 4) {
+			uint32_t p[4];
+			for (int k = 0; k < 4; k++) memcpy(&p[k], src + (i + k) * 3, 4);
+			__m128i rgbx = _mm_setr_epi32((int)p[0], (int)p[1], (int)p[2], (int)p[3]);
+			__m128i bgra = _mm_or_si128(_mm_or_si128(_mm_and_si128(rgbx, _mm_set1_epi32(0xFF00)), opaque),
+				_mm_or_si128(_mm_slli_epi32(_mm_and_si128(rgbx, low), 16), _mm_and_si128(_mm_srli_epi32(rgbx, 16), low)));
+			_mm_storeu_si128((__m128i*)(dst + i * 4), bgra);
+		}
+	}
+#endif
+	for (; i < pixelCount; i++) {
+		const unsigned char* s = src + i * channels;
+		unsigned char* d = dst + i * 4;
+		d[0] = s[2];
+		d[1] = s[1];
+		d[2] = s[0];
+		d[3] = channels == 4 ? s[3] : 255;
+	}
+}
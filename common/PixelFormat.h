@@ -0,0 +1,29 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <cstddef>
+/*
+	Choosing what glTexImage gets for 8-bit images, so the driver can copy instead of convert,
+	* sized internal formats (GL_R8 / GL_RG8 / GL_RGB8 / GL_RGBA8), never plain GL_RGB
+	* with expandToBGRA, 3 and 4 channel images are uploaded as GL_BGRA + UNSIGNED_INT_8_8_8_8_REV,
+	  the layout desktop drivers store RGBA8 in; the expansion runs on a worker (expandToBGRA8)
+	* 1 and 2 channel images stay small and are swizzled to grey / grey + alpha in the texture
+	* unpackAlignment() gives the largest GL_UNPACK_ALIGNMENT a tightly packed row allows
+*/
+struct UploadFormat
+{
+	GLenum internalFormat = GL_RGBA8;
+	GLenum format = GL_RGBA;
+	GLenum type = GL_UNSIGNED_BYTE;
+	int bytesPerPixel = 4;
+	bool expand = false;	// source pixels have to go through expandToBGRA8 first
+};
+
+UploadFormat negotiateUploadFormat(int channels, bool expandToBGRA);
+GLint unpackAlignment(size_t rowBytes);
+
+// sets GL_TEXTURE_SWIZZLE_* of the bound texture for 1 and 2 channel images
+void applyChannelSwizzle(GLenum target, int channels);
+
+// RGB or RGBA pixels -> BGRA (alpha 255 for RGB), SSE2 when available
+void expandToBGRA8(const unsigned char* src, int channels, size_t pixelCount, unsigned char* dst);
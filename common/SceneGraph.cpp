@@ -0,0 +1,120 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+void SceneGraph::reserve(size_t count) {
+	locals.reserve(count);
+	worlds.reserve(count);
+	parents.reserve(count);
+	subtreeEnds.reserve(count);
+	dirty.reserve(count);
+	ids.reserve(count);
+	indices.reserve(count);
+}
+
+SceneGraph::NodeId SceneGraph::add(NodeId parent, const Transform& local) {
+	int parentIndex = parent == ROOT ? -1 : indices[parent];
+	int at = parentIndex < 0 ? (int)locals.size() : subtreeEnds[parentIndex];
+	NodeId id = (NodeId)indices.size();
+
+	if (at < (int)locals.size()) {
+		// the parent's subtree is not at the end: open a slot, everything after it moves by one
+		for (size_t i = at; i < locals.size(); i++) {
+			if (parents[i] >= at) parents[i]++;
+			subtreeEnds[i]++;
+			indices[ids[i]]++;
+		}
+		locals.insert(locals.begin() + at, local);
+		worlds.insert(worlds.begin() + at, glm::mat4(1.0f));
+		parents.insert(parents.begin() + at, parentIndex);
+		subtreeEnds.insert(subtreeEnds.begin() + at, at + 1);
+		dirty.insert(dirty.begin() + at, 0);
+		ids.insert(ids.begin() + at, id);
+	}
+	else {
+		locals.push_back(local);
+		worlds.push_back(glm::mat4(1.0f));
+		parents.push_back(parentIndex);
+		subtreeEnds.push_back(at + 1);
+		dirty.push_back(0);
+		ids.push_back(id);
+	}
+	indices.push_back(at);
+
+	// the new node lies inside the subtree of every ancestor
+	for (int a = parentIndex; a >= 0; a = parents[a]) subtreeEnds[a]++;
+
+	markDirty(at);
+	return id;
+}
+
+SceneGraph::NodeId SceneGraph::parent(NodeId id) const {
+	int p = parents[indices[id]];
+	return p < 0 ? ROOT : ids[p];
+}
+
+void SceneGraph::markDirty(int index) {
+	if (dirty[index]) return;
+	dirty[index] = 1;
+	dirtyNodes.push_back(ids[index]);
+}
+
+void SceneGraph::setLocal(NodeId id, const Transform& local) {
+	int i = indices[id];
+	locals[i] = local;
+	markDirty(i);
+}
+
+void SceneGraph::setTranslation(NodeId id, const glm::vec3& translation) {
+	int i = indices[id];
+	locals[i].translation = translation;
+	markDirty(i);
+}
+
+void SceneGraph::setRotation(NodeId id, const glm::quat& rotation) {
+	int i = indices[id];
+	locals[i].rotation = rotation;
+	markDirty(i);
+}
+
+void SceneGraph::setScale(NodeId id, const glm::vec3& scale) {
+	int i = indices[id];
+	locals[i].scale = scale;
+	markDirty(i);
+}
+
+glm::mat4 SceneGraph::compose(const Transform& t) {
+	glm::mat4 m = glm::mat4_cast(t.rotation);
+	m[0] = m[0] * t.scale.x;
+	m[1] = m[1] * t.scale.y;
+	m[2] = m[2] * t.scale.z;
+	m[3] = glm::vec4(t.translation, 1.0f);
+	return m;
+}
+
+size_t SceneGraph::update() {
+	if (dirtyNodes.empty()) return 0;
+
+	// in array order a dirty node inside an already recomputed range is covered by its ancestor
+	dirtyOrder.clear();
+	for (NodeId id : dirtyNodes) dirtyOrder.push_back(indices[id]);
+	dirtyNodes.clear();
+	std::sort(dirtyOrder.begin(), dirtyOrder.end());
+
+	size_t updated = 0;
+	int coveredEnd = 0;
+	for (int first : dirtyOrder) {
+		dirty[first] = 0;
+		if (first < coveredEnd) continue;
+
+		// parents come before children, so every parent world in the range is already fresh
+		int end = subtreeEnds[first];
+		for (int i = first; i < end; i++) {
+			int p = parents[i];
+			worlds[i] = p < 0 ? compose(locals[i]) : worlds[p] * compose(locals[i]);
+		}
+		updated += end - first;
+		coveredEnd = end;
+	}
+	return updated;
+}
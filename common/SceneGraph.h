@@ -0,0 +1,65 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <vector>
+/*
+	Parent/child transforms kept in one flat array with cached world matrices,
+		HOW TO USE IT:
+	* NodeId id = graph.add(parent, local) (SceneGraph::ROOT for a top-level node); nodes are kept
+	  depth-first, every parent before its subtree and every subtree one contiguous range, so
+	  building a hierarchy depth-first (children right after their parent) only appends
+	* setLocal / setTranslation / setRotation / setScale mark the node dirty, nothing is computed yet
+	* update() once per frame, before drawing: recomputes world = parentWorld * T * R * S for the
+	  dirty nodes and their subtrees only and returns how many matrices it recomputed; the cost
+	  follows what changed, not the size of the scene
+	* world(id) is the cached model matrix, valid after update()
+	* ids stay valid when nodes are inserted in the middle of the array (indices move, ids do not)
+*/
+struct Transform
+{
+	glm::vec3 translation = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+class SceneGraph
+{
+public:
+	typedef int NodeId;
+	static const NodeId ROOT = -1;
+
+	void reserve(size_t count);
+	NodeId add(NodeId parent, const Transform& local = Transform());
+
+	void setLocal(NodeId id, const Transform& local);
+	void setTranslation(NodeId id, const glm::vec3& translation);
+	void setRotation(NodeId id, const glm::quat& rotation);
+	void setScale(NodeId id, const glm::vec3& scale);
+
+	size_t update();
+
+	const Transform& local(NodeId id) const { return locals[indices[id]]; }
+	const glm::mat4& world(NodeId id) const { return worlds[indices[id]]; }
+	NodeId parent(NodeId id) const;
+	size_t size() const { return locals.size(); }
+
+	// T * R * S of one transform, the same matrix as glm::translate, glm::rotate, glm::scale in a row
+	static glm::mat4 compose(const Transform& t);
+
+private:
+	void markDirty(int index);
+
+	// in depth-first order
+	std::vector<Transform> locals;
+	std::vector<glm::mat4> worlds;
+	std::vector<int> parents;        // index of the parent, -1 for a top-level node
+	std::vector<int> subtreeEnds;    // one past the last descendant
+	std::vector<unsigned char> dirty;
+	std::vector<NodeId> ids;         // id of the node at an index
+
+	std::vector<int> indices;        // index of the node with an id
+	std::vector<NodeId> dirtyNodes;  // marked since the last update
+	std::vector<int> dirtyOrder;
+};
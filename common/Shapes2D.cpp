@@ -0,0 +1,261 @@
+#include "Shapes2D.h"
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SHAPES_SSE2 1
+#endif
+
+static const double PI = 3.14159265358979323846;
+
+// calls emit(i, cos, sin) for start + i * step; four neighbouring angles are rotated together by
+// 4 * step, and every 256 points the lanes restart from exact values so float error cannot build up
+template <typename Emit>
+static void forEachAngle(double start, double step, size_t count, Emit emit) {
+	const size_t BLOCK = 256;
+	double cosStep4 = std::cos(4.0 * step), sinStep4 = std::sin(4.0 * step);
+
+	for (size_t base = 0; base < count; base += BLOCK) {
+		size_t n = count - base < BLOCK ? count - base : BLOCK;
+		float c0[4], s0[4];
+		for (int k = 0; k < 4; k++) {
+			double angle = start + step * (double)(base + k);
+			c0[k] = (float)std::cos(angle);
+			s0[k] = (float)std::sin(angle);
+		}
+
+#ifdef SHAPES_SSE2
+		__m128 c = _mm_loadu_ps(c0), s = _mm_loadu_ps(s0);
+		const __m128 cr = _mm_set1_ps((float)cosStep4), sr = _mm_set1_ps((float)sinStep4);
+		for (size_t i = 0; i < n; i += 4) {
+			float cs[4], ss[4];
+			_mm_storeu_ps(cs, c);
+			_mm_storeu_ps(ss, s);
+			for (size_t k = 0; k < 4 && i + k < n; k++) emit(base + i + k, cs[k], ss[k]);
+
+			__m128 nextC = _mm_sub_ps(_mm_mul_ps(c, cr), _mm_mul_ps(s, sr));
+			s = _mm_add_ps(_mm_mul_ps(s, cr), _mm_mul_ps(c, sr));
+			c = nextC;
+		}
+#else
+		float cr = (float)cosStep4, sr = (float)sinStep4;
+		for (size_t i = 0; i < n; i += 4) {
+			for (size_t k = 0; k < 4 && i + k < n; k++) emit(base + i + k, c0[k], s0[k]);
+			for (int k = 0; k < 4; k++) {
+				float nextC = c0[k] * cr - s0[k] * sr;
+				s0[k] = s0[k] * cr + c0[k] * sr;
+				c0[k] = nextC;
+			}
+		}
+#endif
+	}
+}
+
+static inline void putVertex(const ShapeOutput& out, size_t index, float x, float y, float u, float v) {
+	float* p = out.vertices + index * out.stride;
+	p[0] = x;
+	p[1] = y;
+	if (out.positionComponents == 3) p[2] = 0.0f;
+	if (out.uvOffset >= 0) {
+		p[out.uvOffset] = u;
+		p[out.uvOffset + 1] = v;
+	}
+}
+
+// vertex 0 is the center, 1 .. rimCount the rim; as triangles or as one fan + restart
+static void writeFanIndices(const ShapeOutput& out, unsigned rimCount, bool closed) {
+	if (!out.indices) return;
+	unsigned* index = out.indices;
+
+	if (out.topology == ShapeTopology::Restart) {
+		*index++ = out.baseVertex;
+		for (unsigned i = 0; i < rimCount; i++)
+			*index++ = out.baseVertex + 1 + i;
+		if (closed) *index++ = out.baseVertex + 1;
+		*index++ = SHAPE_RESTART_INDEX;
+		return;
+	}
+
+	unsigned triangles = closed ? rimCount : rimCount - 1;
+	for (unsigned i = 0; i < triangles; i++) {
+		*index++ = out.baseVertex;
+		*index++ = out.baseVertex + 1 + i;
+		*index++ = out.baseVertex + 1 + (i + 1) % rimCount;
+	}
+}
+
+// rim of `rim` vertices around a center, closed or open (arc)
+static ShapeSize fanSize(size_t rim, bool closed, ShapeTopology topology) {
+	ShapeSize size;
+	size.vertices = rim + 1;
+	if (topology == ShapeTopology::Restart)
+		size.indices = 1 + rim + (closed ? 1 : 0) + 1;
+	else
+		size.indices = 3 * (closed ? rim : rim - 1);
+	return size;
+}
+
+ShapeSize circleSize(int segments, ShapeTopology topology) {
+	if (segments < 3) segments = 3;
+	return fanSize(segments, true, topology);
+}
+
+ShapeSize arcSize(int segments, ShapeTopology topology) {
+	if (segments < 1) segments = 1;
+	return fanSize(segments + 1, false, topology);
+}
+
+ShapeSize ringSize(int segments, ShapeTopology topology) {
+	if (segments < 3) segments = 3;
+	ShapeSize size;
+	size.vertices = 2 * (size_t)segments;
+	size.indices = topology == ShapeTopology::Restart ? 2 * (size_t)segments + 3 : 6 * (size_t)segments;
+	return size;
+}
+
+ShapeSize roundedRectSize(int cornerSegments, ShapeTopology topology) {
+	if (cornerSegments < 1) cornerSegments = 1;
+	return fanSize(4 * (size_t)(cornerSegments + 1), true, topology);
+}
+
+ShapeSize circleQuadSize(ShapeTopology topology) {
+	ShapeSize size;
+	size.vertices = 4;
+	size.indices = topology == ShapeTopology::Restart ? 5 : 6;
+	return size;
+}
+
+ShapeSize writeCircle(const ShapeOutput& out, float cx, float cy, float radius, int segments) {
+	return writeEllipse(out, cx, cy, radius, radius, segments);
+}
+
+ShapeSize writeEllipse(const ShapeOutput& out, float cx, float cy, float rx, float ry, int segments) {
+	ShapeSize size = circleSize(segments, out.topology);
+	unsigned rim = (unsigned)size.vertices - 1;
+
+	putVertex(out, 0, cx, cy, 0.5f, 0.5f);
+	forEachAngle(0.0, 2.0 * PI / rim, rim, [&](size_t i, float c, float s) {
+		putVertex(out, i + 1, cx + rx * c, cy + ry * s, (c + 1.0f) * 0.5f, (s + 1.0f) * 0.5f);
+	});
+	writeFanIndices(out, rim, true);
+	return size;
+}
+
+ShapeSize writeArc(const ShapeOutput& out, float cx, float cy, float radius, float startAngle, float sweep, int segments) {
+	ShapeSize size = arcSize(segments, out.topology);
+	unsigned rim = (unsigned)size.vertices - 1;
+
+	putVertex(out, 0, cx, cy, 0.5f, 0.5f);
+	forEachAngle(startAngle, (double)sweep / (rim - 1), rim, [&](size_t i, float c, float s) {
+		putVertex(out, i + 1, cx + radius * c, cy + radius * s, (c + 1.0f) * 0.5f, (s + 1.0f) * 0.5f);
+	});
+	writeFanIndices(out, rim, false);
+	return size;
+}
+
+ShapeSize writeRing(const ShapeOutput& out, float cx, float cy, float innerRadius, float outerRadius, int segments) {
+	ShapeSize size = ringSize(segments, out.topology);
+	unsigned n = (unsigned)size.vertices / 2;
+	float ratio = outerRadius > 0.0f ? innerRadius / outerRadius : 0.0f;
+
+	// outer and inner vertex of every angle next to each other
+	forEachAngle(0.0, 2.0 * PI / n, n, [&](size_t i, float c, float s) {
+		putVertex(out, 2 * i, cx + outerRadius * c, cy + outerRadius * s, (c + 1.0f) * 0.5f, (s + 1.0f) * 0.5f);
+		putVertex(out, 2 * i + 1, cx + innerRadius * c, cy + innerRadius * s, (c * ratio + 1.0f) * 0.5f, (s * ratio + 1.0f) * 0.5f);
+	});
+
+	if (out.indices && out.topology == ShapeTopology::Restart) {
+		// one strip around the ring, back to the first pair, then the restart
+		unsigned* index = out.indices;
+		for (unsigned i = 0; i < 2 * n; i++)
+			*index++ = out.baseVertex + i;
+		*index++ = out.baseVertex;
+		*index++ = out.baseVertex + 1;
+		*index++ = SHAPE_RESTART_INDEX;
+	}
+	else if (out.indices) {
+		unsigned* index = out.indices;
+		for (unsigned i = 0; i < n; i++) {
+			unsigned outer = out.baseVertex + 2 * i, inner = outer + 1;
+			unsigned nextOuter = out.baseVertex + 2 * ((i + 1) % n), nextInner = nextOuter + 1;
+			*index++ = outer; *index++ = inner; *index++ = nextOuter;
+			*index++ = inner; *index++ = nextInner; *index++ = nextOuter;
+		}
+	}
+	return size;
+}
+
+ShapeSize writeRoundedRect(const ShapeOutput& out, float cx, float cy, float halfWidth, float halfHeight,
+	float cornerRadius, int cornerSegments) {
+	ShapeSize size = roundedRectSize(cornerSegments, out.topology);
+	unsigned perCorner = (unsigned)(size.vertices - 1) / 4;
+	float r = cornerRadius;
+	if (r > halfWidth) r = halfWidth;
+	if (r > halfHeight) r = halfHeight;
+	if (r < 0.0f) r = 0.0f;
+
+	putVertex(out, 0, cx, cy, 0.5f, 0.5f);
+	// counter-clockwise from the right edge, one quarter circle per corner
+	const float cornerX[4] = { halfWidth - r, -halfWidth + r, -halfWidth + r, halfWidth - r };
+	const float cornerY[4] = { halfHeight - r, halfHeight - r, -halfHeight + r, -halfHeight + r };
+	for (int corner = 0; corner < 4; corner++) {
+		size_t first = 1 + corner * perCorner;
+		forEachAngle(corner * PI / 2.0, (PI / 2.0) / (perCorner - 1), perCorner, [&](size_t i, float c, float s) {
+			float x = cornerX[corner] + r * c, y = cornerY[corner] + r * s;
+			putVertex(out, first + i, cx + x, cy + y,
+				halfWidth > 0.0f ? (x / halfWidth + 1.0f) * 0.5f : 0.5f,
+				halfHeight > 0.0f ? (y / halfHeight + 1.0f) * 0.5f : 0.5f);
+		});
+	}
+	writeFanIndices(out, 4 * perCorner, true);
+	return size;
+}
+
+ShapeSize writeCircleQuad(const ShapeOutput& out, float cx, float cy, float radius, float padding) {
+	ShapeSize size = circleQuadSize(out.topology);
+	float half = radius + padding;
+	float local = radius > 0.0f ? half / radius : 1.0f;
+
+	// strip order: bottom left, bottom right, top left, top right
+	for (int corner = 0; corner < 4; corner++) {
+		float sx = (corner & 1) ? 1.0f : -1.0f, sy = (corner & 2) ? 1.0f : -1.0f;
+		putVertex(out, corner, cx + sx * half, cy + sy * half, sx * local, sy * local);
+	}
+
+	if (out.indices) {
+		unsigned* index = out.indices;
+		if (out.topology == ShapeTopology::Restart) {
+			for (unsigned i = 0; i < 4; i++)
+				*index++ = out.baseVertex + i;
+			*index++ = SHAPE_RESTART_INDEX;
+		}
+		else {
+			const unsigned quad[6] = { 0, 1, 2, 2, 1, 3 };
+			for (unsigned i = 0; i < 6; i++)
+				*index++ = out.baseVertex + quad[i];
+		}
+	}
+	return size;
+}
+
+int circleSegmentsForError(float radiusPixels, float maxErrorPixels, int minSegments, int maxSegments) {
+	// the sagitta r * (1 - cos(theta / 2)) of a segment spanning theta must stay below the error
+	int segments = minSegments;
+	if (maxErrorPixels > 0.0f && radiusPixels > maxErrorPixels) {
+		double theta = 2.0 * std::acos(1.0 - (double)maxErrorPixels / radiusPixels);
+		double exact = std::ceil(2.0 * PI / theta);
+		segments = exact > maxSegments ? maxSegments : (int)exact;
+	}
+	segments = (segments + SEGMENT_BUCKET - 1) / SEGMENT_BUCKET * SEGMENT_BUCKET;
+	if (segments < minSegments) segments = minSegments;
+	if (segments > maxSegments) segments = maxSegments;
+	return segments;
+}
+
+void sincosSteps(float start, float step, size_t count, float* cosOut, float* sinOut) {
+	forEachAngle(start, step, count, [&](size_t i, float c, float s) {
+		cosOut[i] = c;
+		sinOut[i] = s;
+	});
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+/*
+	Parametric 2D shapes written straight into caller-provided buffers,
+		HOW TO USE IT:
+	* ask for the size first (circleSize(N), ringSize(N), ...), size the buffers once, then call
+	  the matching write* function - nothing is allocated while writing
+	* ShapeOutput describes the interleaved vertex layout: stride floats per vertex, position
+	  (2 or 3 components, z = 0) and optional uv (bounding box mapped to [0, 1])
+	* baseVertex is added to every index so several shapes can share one buffer,
+	  indices == nullptr writes vertices only
+	* ShapeTopology::Triangles writes GL_TRIANGLES (3 indices per triangle), ShapeTopology::Restart
+	  writes each shape as one fan (circle, ellipse, arc, rounded rect -> GL_TRIANGLE_FAN) or strip
+	  (ring -> GL_TRIANGLE_STRIP) closed by SHAPE_RESTART_INDEX; with
+	  glEnable(GL_PRIMITIVE_RESTART) + glPrimitiveRestartIndex(SHAPE_RESTART_INDEX) any number of
+	  shapes of one kind is a single draw, a 100 segment circle takes 103 indices instead of 300
+	* writeCircleQuad is the geometry of an analytic (SDF) circle: one square of radius + padding
+	  with uv = position relative to the center in radii, so length(uv) == 1 on the rim and the
+	  fragment shader computes the coverage; as GL_TRIANGLES or one GL_TRIANGLE_STRIP + restart
+	* circleSegmentsForError picks the segment count from the radius on screen: the chord of each
+	  segment stays within maxErrorPixels of the true circle, rounded up to a multiple of
+	  SEGMENT_BUCKET so a slowly changing radius re-tessellates only when the bucket changes
+	* angles are in radians; the rim is generated with a 4-wide angle-addition recurrence
+	  (SSE2 when available), resynchronized with exact sin/cos every 256 points
+*/
+const unsigned SHAPE_RESTART_INDEX = 0xFFFFFFFFu;
+
+enum class ShapeTopology { Triangles, Restart };
+
+struct ShapeOutput
+{
+	float* vertices = nullptr;
+	int stride = 2;				// floats per vertex
+	int positionComponents = 2;	// 2 or 3
+	int uvOffset = -1;			// first uv float inside a vertex, -1 = no uv
+	unsigned* indices = nullptr;
+	unsigned baseVertex = 0;
+	ShapeTopology topology = ShapeTopology::Triangles;
+};
+
+struct ShapeSize
+{
+	size_t vertices = 0;
+	size_t indices = 0;
+};
+
+const int SEGMENT_BUCKET = 8;
+
+ShapeSize circleSize(int segments, ShapeTopology topology = ShapeTopology::Triangles);
+ShapeSize arcSize(int segments, ShapeTopology topology = ShapeTopology::Triangles);
+ShapeSize ringSize(int segments, ShapeTopology topology = ShapeTopology::Triangles);
+ShapeSize roundedRectSize(int cornerSegments, ShapeTopology topology = ShapeTopology::Triangles);
+ShapeSize circleQuadSize(ShapeTopology topology = ShapeTopology::Triangles);
+
+// filled, center vertex + segments rim vertices
+ShapeSize writeCircle(const ShapeOutput& out, float cx, float cy, float radius, int segments);
+ShapeSize writeEllipse(const ShapeOutput& out, float cx, float cy, float rx, float ry, int segments);
+// pie slice from startAngle over sweep
+ShapeSize writeArc(const ShapeOutput& out, float cx, float cy, float radius, float startAngle, float sweep, int segments);
+ShapeSize writeRing(const ShapeOutput& out, float cx, float cy, float innerRadius, float outerRadius, int segments);
+// halfWidth / halfHeight around the center, cornerSegments per quarter circle
+ShapeSize writeRoundedRect(const ShapeOutput& out, float cx, float cy, float halfWidth, float halfHeight,
+	float cornerRadius, int cornerSegments);
+// padding in the units of the position (e.g. 1 pixel) leaves room for the anti-aliased edge
+ShapeSize writeCircleQuad(const ShapeOutput& out, float cx, float cy, float radius, float padding);
+
+// segments for a circle of radiusPixels on screen with at most maxErrorPixels between chord and arc
+int circleSegmentsForError(float radiusPixels, float maxErrorPixels, int minSegments, int maxSegments);
+
+// cos / sin of start + i * step for i in [0, count), the same recurrence the shapes use
+void sincosSteps(float start, float step, size_t count, float* cosOut, float* sinOut);
@@ -0,0 +1,201 @@
+#include "TextureBudget.h"
+
+#include <iostream>
+
+#include "PixelFormat.h"
+
+size_t textureBytes(const TextureSlot& slot) {
+	if (!slot.texture) return 0;
+
+	size_t total = 0;
+	int levels = slot.levels > 0 ? slot.levels : 1;
+	for (int level = 0; level < levels; level++) {
+		size_t w = slot.width >> level > 0 ? slot.width >> level : 1;
+		size_t h = slot.height >> level > 0 ? slot.height >> level : 1;
+		if (slot.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+			total += ((w + 3) / 4) * ((h + 3) / 4) * 8;
+		else if (slot.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+			total += ((w + 3) / 4) * ((h + 3) / 4) * 16;
+		else if (slot.internalFormat == GL_R8)
+			total += w * h;
+		else if (slot.internalFormat == GL_RG8)
+			total += w * h * 2;
+		else
+			total += w * h * 4;		// drivers keep RGB8 padded to 4 bytes as well
+	}
+	return total * (slot.layers > 0 ? slot.layers : 1);
+}
+
+TextureBudget::TextureBudget(TextureLoader& loader, size_t budgetBytes)
+	: budgetBytes(budgetBytes), loader(loader) {
+	loader.thumbnailSize = THUMBNAIL_SIZE;
+}
+
+TextureBudget::Entry& TextureBudget::track(TextureSlot& slot) {
+	std::unordered_map<TextureSlot*, size_t>::iterator found = entryOf.find(&slot);
+	if (found != entryOf.end()) return entries[found->second];
+
+	entryOf[&slot] = entries.size();
+	entries.push_back(Entry());
+	entries.back().slot = &slot;
+	return entries.back();
+}
+
+void TextureBudget::load(TextureSlot& slot, const std::string& path) {
+	Entry& entry = track(slot);
+	entry.paths.assign(1, path);
+	entry.ktx2Path.clear();
+	entry.isArray = false;
+	entry.lastBound = frame;
+	loader.load(slot, path);
+}
+
+void TextureBudget::loadArray(TextureSlot& slot, const std::vector<std::string>& paths, const std::string& ktx2Path) {
+	Entry& entry = track(slot);
+	entry.paths = paths;
+	entry.ktx2Path = ktx2Path;
+	entry.isArray = true;
+	entry.lastBound = frame;
+	loader.loadArray(slot, paths, ktx2Path);
+}
+
+void TextureBudget::reload(Entry& entry) {
+	if (entry.isArray) loader.loadArray(*entry.slot, entry.paths, entry.ktx2Path);
+	else loader.load(*entry.slot, entry.paths[0]);
+	entry.reloading = true;
+	entry.reloadGeneration = entry.slot->requested;
+}
+
+// a one-level texture from the small mip level the loader kept on the CPU (slot.thumbnail),
+// nothing is read back from the GPU; 0 when the texture had no level that small
+static GLuint makeThumbnail(TextureSlot& slot) {
+	if (slot.thumbnail.empty()) return 0;
+	GLsizei w = slot.thumbnailWidth, h = slot.thumbnailHeight;
+	bool isArray = slot.target == GL_TEXTURE_2D_ARRAY;
+	GLsizei layers = isArray ? slot.layers : 1;
+	bool compressed = slot.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+		|| slot.internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+	GLuint thumbnail;
+	glGenTextures(1, &thumbnail);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindTexture(slot.target, thumbnail);
+	glTexParameteri(slot.target, GL_TEXTURE_WRAP_S, slot.wrapS);
+	glTexParameteri(slot.target, GL_TEXTURE_WRAP_T, slot.wrapT);
+	glTexParameteri(slot.target, GL_TEXTURE_MIN_FILTER, slot.minFilter);
+	glTexParameteri(slot.target, GL_TEXTURE_MAG_FILTER, slot.magFilter);
+	glTexParameteri(slot.target, GL_TEXTURE_MAX_LEVEL, 0);
+	const unsigned char* pixels = slot.thumbnail.data();
+	GLsizei size = (GLsizei)slot.thumbnail.size();
+	if (compressed && isArray)
+		glCompressedTexImage3D(slot.target, 0, slot.internalFormat, w, h, layers, 0, size, pixels);
+	else if (compressed)
+		glCompressedTexImage2D(slot.target, 0, slot.internalFormat, w, h, 0, size, pixels);
+	else {
+		// the kept level is tightly packed source texels, no BGRA expansion
+		UploadFormat upload = negotiateUploadFormat(slot.nrChannels, false);
+		applyChannelSwizzle(slot.target, slot.nrChannels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment((size_t)w * upload.bytesPerPixel));
+		if (isArray)
+			glTexImage3D(slot.target, 0, upload.internalFormat, w, h, layers, 0, upload.format, upload.type, pixels);
+		else
+			glTexImage2D(slot.target, 0, upload.internalFormat, w, h, 0, upload.format, upload.type, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		slot.internalFormat = upload.internalFormat;
+	}
+	glBindTexture(slot.target, 0);
+
+	slot.width = w;
+	slot.height = h;
+	slot.levels = 1;
+	std::vector<unsigned char>().swap(slot.thumbnail);
+	return thumbnail;
+}
+
+void TextureBudget::evict(Entry& entry) {
+	TextureSlot& slot = *entry.slot;
+	GLuint full = slot.texture;
+	entry.thumbnail = makeThumbnail(slot);
+	glDeleteTextures(1, &full);
+	slot.texture = entry.thumbnail;
+
+	current -= entry.bytes;
+	evicted += entry.bytes;
+	entry.counted = slot.texture;
+	entry.bytes = textureBytes(slot);
+	current += entry.bytes;
+	entry.evicted = true;
+}
+
+void TextureBudget::bind(TextureSlot& slot) {
+	std::unordered_map<TextureSlot*, size_t>::iterator found = entryOf.find(&slot);
+	if (found != entryOf.end()) {
+		Entry& entry = entries[found->second];
+		entry.lastBound = frame;
+		if (entry.evicted && !entry.reloading && frame >= entry.retryFrame) reload(entry);
+	}
+	glBindTexture(slot.target, slot.texture);
+}
+
+void TextureBudget::update() {
+	// the loader swaps textures in on its own, anything new is measured here
+	current = 0;
+	for (Entry& entry : entries) {
+		TextureSlot& slot = *entry.slot;
+		if (slot.texture != entry.counted) {
+			// the loader swapped in a full texture (and deleted the thumbnail it replaced)
+			entry.counted = slot.texture;
+			entry.bytes = textureBytes(slot);
+			if (entry.counted) {
+				entry.evicted = entry.reloading = false;
+				entry.thumbnail = 0;
+			}
+		}
+		else if (entry.reloading && slot.failed >= entry.reloadGeneration && slot.loaded < entry.reloadGeneration) {
+			// this reload, or a newer load that replaced it, failed: keep the thumbnail, try later
+			entry.reloading = false;
+			entry.retryFrame = frame + RETRY_FRAMES;
+			failures++;
+			std::cout << "Texture reload failed: " << entry.paths[0] << ", retrying in "
+				<< RETRY_FRAMES << " frames" << std::endl;
+		}
+		current += entry.bytes;
+	}
+	if (current > peak) peak = current;
+
+	// least recently bound first, the textures of the current frame stay
+	while (current > budgetBytes) {
+		Entry* oldest = nullptr;
+		for (Entry& entry : entries)
+			if (entry.counted && !entry.evicted && entry.lastBound < frame && (!oldest || entry.lastBound < oldest->lastBound))
+				oldest = &entry;
+		if (!oldest) break;
+		evict(*oldest);
+	}
+	frame++;
+}
+
+void TextureBudget::release(TextureSlot& slot) {
+	std::unordered_map<TextureSlot*, size_t>::iterator found = entryOf.find(&slot);
+	if (found == entryOf.end()) return;
+
+	current -= entries[found->second].bytes;
+	if (slot.texture) glDeleteTextures(1, &slot.texture);
+	slot.texture = 0;
+
+	// swap with the last entry to keep the array dense
+	size_t index = found->second;
+	entryOf.erase(found);
+	if (index + 1 != entries.size()) {
+		entries[index] = entries.back();
+		entryOf[entries[index].slot] = index;
+	}
+	entries.pop_back();
+}
+
+void TextureBudget::printStats() const {
+	const double MB = 1024.0 * 1024.0;
+	std::cout << "Texture memory: current " << current / MB << " MB, peak " << peak / MB
+		<< " MB, evicted " << evicted / MB << " MB (budget " << budgetBytes / MB << " MB), "
+		<< failures << " failed reloads" << std::endl;
+}
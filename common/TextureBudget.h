@@ -0,0 +1,79 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureLoader.h"
+/*
+	Texture memory accounting on top of TextureLoader,
+		HOW TO USE IT:
+	* load textures through the budget (load / loadArray), it remembers the sources
+	* bind(slot) instead of glBindTexture, it marks the slot as used in this frame and
+	  reloads it (in the background, like the first load) if it was evicted
+	* call update() once per frame after loader.update(): new uploads are counted (every mip level,
+	  every layer, S3TC by blocks) and while the total is over budgetBytes the least recently
+	  bound textures are evicted - never one that was bound in the previous frame
+	* an evicted texture keeps a thumbnail: its first mip level of at most THUMBNAIL_SIZE texels,
+	  which the loader keeps on the CPU after every upload (the budget sets loader.thumbnailSize),
+	  goes into a one-level texture before the full one is deleted - no readback, no stall - so a
+	  bind() before the reload finishes shows a blurry image instead of texture 0
+	* a reload that fails (file gone, decode error) is reported, the thumbnail stays and the
+	  reload is tried again RETRY_FRAMES later
+	* currentBytes / peakBytes / evictedBytes / failedReloads tell how much memory the textures
+	  really need and whether evicted ones came back
+*/
+size_t textureBytes(const TextureSlot& slot);
+
+class TextureBudget
+{
+public:
+	TextureBudget(TextureLoader& loader, size_t budgetBytes);
+
+	void load(TextureSlot& slot, const std::string& path);
+	void loadArray(TextureSlot& slot, const std::vector<std::string>& paths, const std::string& ktx2Path = "");
+	void bind(TextureSlot& slot);
+	void update();
+	void release(TextureSlot& slot);
+
+	size_t currentBytes() const { return current; }
+	size_t peakBytes() const { return peak; }
+	size_t evictedBytes() const { return evicted; }
+	unsigned failedReloads() const { return failures; }
+	void printStats() const;
+
+	size_t budgetBytes;
+
+	static const int THUMBNAIL_SIZE = 32;
+	static const unsigned RETRY_FRAMES = 120;
+
+private:
+	struct Entry
+	{
+		TextureSlot* slot = nullptr;
+		std::vector<std::string> paths;
+		std::string ktx2Path;
+		bool isArray = false;
+
+		GLuint counted = 0;		// texture whose size is in bytes
+		size_t bytes = 0;
+		unsigned lastBound = 0;
+		bool evicted = false;
+		bool reloading = false;
+		GLuint thumbnail = 0;		// shown in the slot while evicted, 0 when none could be made
+		unsigned reloadGeneration = 0;
+		unsigned retryFrame = 0;
+	};
+
+	TextureLoader& loader;
+	std::vector<Entry> entries;
+	std::unordered_map<TextureSlot*, size_t> entryOf;
+	unsigned frame = 1;
+	size_t current = 0, peak = 0, evicted = 0;
+	unsigned failures = 0;
+
+	Entry& track(TextureSlot& slot);
+	void reload(Entry& entry);
+	void evict(Entry& entry);
+};
@@ -0,0 +1,208 @@
+#include "TextureCompressor.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <stb_image.h>
+
+#include "ImageUtils.h"
+#include "MipGenerator.h"
+
+static unsigned short packRGB565(const float* c) {
+	int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+	int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+	int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackRGB565(unsigned short c, float* out) {
+	int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	out[0] = (float)((r << 3) | (r >> 2));
+	out[1] = (float)((g << 2) | (g >> 4));
+	out[2] = (float)((b << 3) | (b >> 2));
+}
+
+// 4-color BC1 block: endpoints from the extremes along the principal axis of the block colors
+static void encodeColorBlock(const unsigned char block[16][4], unsigned char* out) {
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 3; c++) mean[c] += block[i][c] / 16.0f;
+
+	float cov[6] = { 0.0f };
+	for (int i = 0; i < 16; i++) {
+		float d[3] = { block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2] };
+		cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+	}
+
+	// a few power iterations are plenty for a 3x3 matrix
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int it = 0; it < 4; it++) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float len = std::sqrt(x * x + y * y + z * z);
+		if (len < 1e-6f) break;
+		axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+	}
+
+	float minT = 1e30f, maxT = -1e30f;
+	int minI = 0, maxI = 0;
+	for (int i = 0; i < 16; i++) {
+		float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+		if (t < minT) { minT = t; minI = i; }
+		if (t > maxT) { maxT = t; maxI = i; }
+	}
+
+	float hi[3] = { (float)block[maxI][0], (float)block[maxI][1], (float)block[maxI][2] };
+	float lo[3] = { (float)block[minI][0], (float)block[minI][1], (float)block[minI][2] };
+	unsigned short c0 = packRGB565(hi), c1 = packRGB565(lo);
+	if (c0 < c1) { unsigned short t = c0; c0 = c1; c1 = t; }	// c0 > c1 selects the 4-color mode
+
+	unsigned indices = 0;
+	if (c0 != c1) {
+		float palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			float bestError = 1e30f;
+			for (int p = 0; p < 4; p++) {
+				float dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				float error = dr * dr + dg * dg + db * db;
+				if (error < bestError) { bestError = error; best = p; }
+			}
+			indices |= (unsigned)best << (2 * i);
+		}
+	}
+
+	out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+	for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// BC3 alpha block, 8-value mode (alpha0 > alpha1)
+static void encodeAlphaBlock(const unsigned char block[16][4], unsigned char* out) {
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++) {
+		if (block[i][3] > a0) a0 = block[i][3];
+		if (block[i][3] < a1) a1 = block[i][3];
+	}
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+
+	unsigned long long bits = 0;
+	if (a0 > a1) {
+		int palette[8] = { a0, a1 };
+		for (int p = 1; p < 7; p++) palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+		for (int i = 0; i < 16; i++) {
+			int best = 0, bestError = 256;
+			for (int p = 0; p < 8; p++) {
+				int error = std::abs(block[i][3] - palette[p]);
+				if (error < bestError) { bestError = error; best = p; }
+			}
+			bits |= (unsigned long long)best << (3 * i);
+		}
+	}
+	for (int i = 0; i < 6; i++) out[2 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+size_t compressedSize(int width, int height, BlockFormat format) {
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == BlockFormat::BC3 ? 16 : 8);
+}
+
+void compressRGBA8(const unsigned char* rgba, int width, int height, BlockFormat format,
+	unsigned char* out, ThreadPool& pool) {
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockBytes = format == BlockFormat::BC3 ? 16 : 8;
+
+	pool.parallelFor(blocksY, [&](size_t begin, size_t end) {
+		unsigned char block[16][4];
+		for (size_t by = begin; by < end; by++) {
+			for (int bx = 0; bx < blocksX; bx++) {
+				// edge blocks repeat the last row / column
+				for (int i = 0; i < 16; i++) {
+					int x = bx * 4 + (i & 3), y = (int)by * 4 + (i >> 2);
+					if (x >= width) x = width - 1;
+					if (y >= height) y = height - 1;
+					memcpy(block[i], rgba + ((size_t)y * width + x) * 4, 4);
+				}
+				unsigned char* dst = out + (by * blocksX + bx) * blockBytes;
+				if (format == BlockFormat::BC3) {
+					encodeAlphaBlock(block, dst);
+					encodeColorBlock(block, dst + 8);
+				}
+				else {
+					encodeColorBlock(block, dst);
+				}
+			}
+		}
+	});
+}
+
+bool compressImages(const std::vector<std::string>& sources, const std::string& ktx2Path,
+	BlockFormat format, bool asArray, ThreadPool& pool) {
+	if (sources.empty()) return false;
+
+	std::vector<unsigned char*> images(sources.size(), nullptr);
+	std::vector<int> widths(sources.size()), heights(sources.size());
+	int width = 0, height = 0;
+	bool ok = true;
+	for (size_t i = 0; i < sources.size(); i++) {
+		int channels;
+		images[i] = stbi_load(sources[i].c_str(), &widths[i], &heights[i], &channels, 4);
+		if (!images[i]) {
+			std::cout << "Failed to load texture " << sources[i] << std::endl;
+			ok = false;
+			break;
+		}
+		if (widths[i] > width) width = widths[i];
+		if (heights[i] > height) height = heights[i];
+	}
+
+	Ktx2Image ktx;
+	if (ok) {
+		ktx.vkFormat = format == BlockFormat::BC3 ? KTX2_VK_FORMAT_BC3_UNORM : KTX2_VK_FORMAT_BC1_RGB_UNORM;
+		ktx.width = width;
+		ktx.height = height;
+		ktx.layers = (asArray || sources.size() > 1) ? (uint32_t)sources.size() : 0;
+		if (ktx.layers > 0) {
+			std::ostringstream sizes;
+			for (size_t i = 0; i < sources.size(); i++)
+				sizes << (i ? " " : "") << widths[i] << " " << heights[i];
+			ktx.metadata[KTX2_KEY_LAYER_SIZES] = sizes.str();
+		}
+
+		MipOptions mipOptions;
+		if (format == BlockFormat::BC3) mipOptions.alphaCutoff = 0.5f;
+		ktx.levels.resize(mipLevelCount(width, height));
+
+		for (size_t layer = 0; layer < sources.size(); layer++) {
+			std::vector<std::vector<unsigned char>> mips(1, std::vector<unsigned char>((size_t)width * height * 4));
+			padRGBA8(images[layer], widths[layer], heights[layer], mips[0].data(), width, height);
+			buildMipChain(mips, width, height, 4, mipOptions);
+
+			for (size_t mip = 0; mip < mips.size(); mip++) {
+				int w = width >> mip > 0 ? width >> mip : 1;
+				int h = height >> mip > 0 ? height >> mip : 1;
+				std::vector<unsigned char>& dst = ktx.levels[mip];
+				size_t offset = dst.size();
+				dst.resize(offset + compressedSize(w, h, format));
+				compressRGBA8(mips[mip].data(), w, h, format, dst.data() + offset, pool);
+			}
+		}
+		ok = writeKtx2(ktx2Path, ktx);
+		if (!ok) std::cout << "Failed to write " << ktx2Path << std::endl;
+	}
+
+	for (unsigned char* image : images)
+		stbi_image_free(image);
+	return ok;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "Ktx2.h"
+#include "ThreadPool.h"
+/*
+	Offline block compression of lab images (BC1 for opaque images, BC3 when alpha matters),
+		HOW TO USE IT:
+	* compressImages({"wall.jpg", ...}, "images.ktx2", ...) decodes, pads every image to the
+	  largest one (padRGBA8, sizes in the KTX2 metadata), builds the full mip chain
+	  (MipGenerator.h) and writes one KTX2 (a texture array when more than one source or
+	  asArray is given)
+	* the encoder runs block rows in parallel on the pool
+	* TextureLoader picks the .ktx2 up instead of the jpg when the driver has S3TC
+*/
+enum class BlockFormat { BC1, BC3 };
+
+// rgba is width * height * 4 bytes, out gets ceil(w/4) * ceil(h/4) blocks
+void compressRGBA8(const unsigned char* rgba, int width, int height, BlockFormat format,
+	unsigned char* out, ThreadPool& pool);
+size_t compressedSize(int width, int height, BlockFormat format);
+
+bool compressImages(const std::vector<std::string>& sources, const std::string& ktx2Path,
+	BlockFormat format, bool asArray, ThreadPool& pool);
@@ -0,0 +1,541 @@
+#include "TextureLoader.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+
+#include <stb_image.h>
+
+#include "ImageUtils.h"
+#include "Ktx2.h"
+
+// modification time of a file, 0 when it does not exist
+static long long fileTime(const std::string& path) {
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) return 0;
+	return (long long)info.st_mtime;
+}
+
+// the KTX2 cache exists and is not older than any source image
+static bool cacheIsFresh(const std::string& ktx2Path, const std::string& path, const std::vector<std::string>& layerPaths) {
+	long long cacheTime = fileTime(ktx2Path);
+	if (cacheTime == 0) return false;
+	if (layerPaths.empty() && fileTime(path) > cacheTime) return false;
+	for (const std::string& layerPath : layerPaths)
+		if (fileTime(layerPath) > cacheTime) return false;
+	return true;
+}
+
+// stored in the caches this loader writes, mips built with other options are stale
+static const char* MIP_OPTIONS_KEY = "GKmipOptions";
+
+static std::string mipOptionsValue(const MipOptions& options) {
+	return std::string("srgb=") + (options.srgb ? "1" : "0") + " alphaCutoff=" + std::to_string(options.alphaCutoff);
+}
+
+TextureLoader::TextureLoader(unsigned threadCount, unsigned stagingBuffers)
+	: pool(threadCount), maxStagingBuffers(stagingBuffers > 0 ? stagingBuffers : 1) {
+	// S3TC is an extension on desktop GL, ask the driver instead of trusting the headers
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &formatCount);
+	std::vector<GLint> formats(formatCount > 0 ? formatCount : 1);
+	if (formatCount > 0) glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+	for (GLint i = 0; i < formatCount; i++) {
+		if (formats[i] == GL_COMPRESSED_RGB_S3TC_DXT1_EXT) hasBC1 = true;
+		if (formats[i] == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) hasBC3 = true;
+	}
+}
+
+TextureLoader::~TextureLoader() {
+	// GL objects must already be gone (shutdown()), the pool joins its workers here
+	for (std::unique_ptr<Job>& job : jobs)
+		while (job->state == Decoding || job->state == Copying)
+			std::this_thread::yield();
+}
+
+void TextureLoader::load(TextureSlot& slot, const std::string& path) {
+	jobs.push_back(std::make_unique<Job>());
+	Job* job = jobs.back().get();
+	job->slot = &slot;
+	job->generation = ++slot.requested;
+	job->path = path;
+	job->ktx2Path = path.substr(0, path.find_last_of('.')) + ".ktx2";
+	job->mipOptions = slot.mipOptions;
+
+	// decode on a worker, the main thread only sees the finished levels
+	pool.enqueue([this, job] {
+		job->cache = loadKtx2(job);
+		if (job->cache != CacheLoaded) decodeImage(job);
+	});
+}
+
+void TextureLoader::loadArray(TextureSlot& slot, const std::vector<std::string>& paths, const std::string& ktx2Path) {
+	jobs.push_back(std::make_unique<Job>());
+	Job* job = jobs.back().get();
+	job->slot = &slot;
+	job->generation = ++slot.requested;
+	job->path = paths.empty() ? std::string() : paths[0];
+	job->layerPaths = paths;
+	job->ktx2Path = ktx2Path;
+	job->mipOptions = slot.mipOptions;
+
+	pool.enqueue([this, job] {
+		job->cache = loadKtx2(job);
+		if (job->cache != CacheLoaded) decodeLayers(job);
+	});
+}
+
+TextureLoader::CacheState TextureLoader::loadKtx2(Job* job) {
+	if (job->ktx2Path.empty()) return CacheKeep;
+
+	// a cache older than any of its sources, or one that cannot be read, is rebuilt
+	if (!cacheIsFresh(job->ktx2Path, job->path, job->layerPaths)) return CacheRebuild;
+
+	Ktx2Image ktx;
+	if (!readKtx2(job->ktx2Path, ktx)) return CacheRebuild;
+
+	// a valid block-compressed file is kept even when this driver cannot use it
+	GLenum compressedFormat = 0;
+	GLint channels;
+	switch (ktx.vkFormat) {
+	case KTX2_VK_FORMAT_BC1_RGB_UNORM:
+		if (!hasBC1) return CacheKeep;
+		compressedFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		channels = 3;
+		break;
+	case KTX2_VK_FORMAT_BC3_UNORM:
+		if (!hasBC3) return CacheKeep;
+		compressedFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		channels = 4;
+		break;
+	case KTX2_VK_FORMAT_R8G8B8_UNORM: channels = 3; break;
+	case KTX2_VK_FORMAT_R8G8B8A8_UNORM: channels = 4; break;
+	default: return CacheRebuild;
+	}
+
+	// an array file has to match the requested layers, a single image must not be an array
+	bool isArray = !job->layerPaths.empty();
+	if (isArray ? ktx.layers != job->layerPaths.size() : ktx.layers > 1)
+		return CacheRebuild;
+
+	// the mips of an uncompressed cache have to come from the slot's current options
+	if (!compressedFormat && ktx.metadata[MIP_OPTIONS_KEY] != mipOptionsValue(job->mipOptions))
+		return CacheRebuild;
+
+	// padded arrays list their images' sizes, older files were resized and fill every layer
+	if (isArray) {
+		std::istringstream sizes(ktx.metadata[KTX2_KEY_LAYER_SIZES]);
+		int size;
+		while (sizes >> size) job->layerSizes.push_back(size);
+		if (job->layerSizes.size() != 2 * ktx.layers) job->layerSizes.clear();
+	}
+
+	size_t total = 0;
+	for (const std::vector<unsigned char>& level : ktx.levels) total += level.size();
+	job->levelData.reserve(total);
+	for (const std::vector<unsigned char>& level : ktx.levels) {
+		job->levelOffsets.push_back(job->levelData.size());
+		job->levelSizes.push_back(level.size());
+		job->levelData.insert(job->levelData.end(), level.begin(), level.end());
+	}
+
+	job->compressedFormat = compressedFormat;
+	job->width = ktx.width;
+	job->height = ktx.height;
+	job->layers = isArray ? (GLint)ktx.layers : 1;
+	job->nrChannels = channels;
+	job->bytes = job->levelData.size();
+	job->state = Decoded;
+	return CacheLoaded;
+}
+
+void TextureLoader::decodeImage(Job* job) {
+	unsigned char* pixels = stbi_load(job->path.c_str(), &job->width, &job->height, &job->nrChannels, 0);
+	if (!pixels) {
+		job->state = Failed;
+		return;
+	}
+
+	std::vector<std::vector<std::vector<unsigned char>>> layerMips(1);
+	layerMips[0].push_back(std::vector<unsigned char>(pixels, pixels + (size_t)job->width * job->height * job->nrChannels));
+	stbi_image_free(pixels);
+	buildMipChain(layerMips[0], job->width, job->height, job->nrChannels, job->mipOptions);
+
+	packLevels(job, layerMips);
+	writeCache(job);
+	job->state = Decoded;
+}
+
+void TextureLoader::decodeLayers(Job* job) {
+	size_t layerCount = job->layerPaths.size();
+	std::vector<unsigned char*> images(layerCount, nullptr);
+	std::vector<int> widths(layerCount), heights(layerCount);
+
+	// every layer is expanded to RGBA so all of them share one format
+	bool ok = layerCount > 0;
+	for (size_t i = 0; i < layerCount && ok; i++) {
+		int channels;
+		images[i] = stbi_load(job->layerPaths[i].c_str(), &widths[i], &heights[i], &channels, 4);
+		if (!images[i]) {
+			job->path = job->layerPaths[i];
+			ok = false;
+		}
+		else {
+			if (widths[i] > job->width) job->width = widths[i];
+			if (heights[i] > job->height) job->height = heights[i];
+			job->layerSizes.push_back(widths[i]);
+			job->layerSizes.push_back(heights[i]);
+		}
+	}
+
+	if (ok) {
+		// padded, not stretched: an image of another aspect ratio keeps its texels
+		std::vector<std::vector<std::vector<unsigned char>>> layerMips(layerCount);
+		for (size_t i = 0; i < layerCount; i++) {
+			layerMips[i].push_back(std::vector<unsigned char>((size_t)job->width * job->height * 4));
+			padRGBA8(images[i], widths[i], heights[i], layerMips[i][0].data(), job->width, job->height);
+			stbi_image_free(images[i]);
+			images[i] = nullptr;
+			buildMipChain(layerMips[i], job->width, job->height, 4, job->mipOptions);
+		}
+		job->nrChannels = 4;
+		job->layers = (GLint)layerCount;
+		packLevels(job, layerMips);
+		writeCache(job);
+	}
+
+	for (unsigned char* image : images)
+		stbi_image_free(image);
+	job->state = ok ? Decoded : Failed;
+}
+
+void TextureLoader::packLevels(Job* job, const std::vector<std::vector<std::vector<unsigned char>>>& layerMips) {
+	// same layout as a KTX2 level and as glTexImage3D expects it: level by level, layers inside
+	size_t levelCount = layerMips[0].size();
+	size_t total = 0;
+	for (const std::vector<std::vector<unsigned char>>& mips : layerMips)
+		for (const std::vector<unsigned char>& level : mips) total += level.size();
+
+	job->levelData.reserve(total);
+	for (size_t level = 0; level < levelCount; level++) {
+		job->levelOffsets.push_back(job->levelData.size());
+		for (const std::vector<std::vector<unsigned char>>& mips : layerMips)
+			job->levelData.insert(job->levelData.end(), mips[level].begin(), mips[level].end());
+		job->levelSizes.push_back(job->levelData.size() - job->levelOffsets.back());
+	}
+	job->bytes = job->levelData.size();
+}
+
+void TextureLoader::writeCache(const Job* job) {
+	// only a missing, stale or broken cache is replaced, never a valid BC file without S3TC
+	if (job->cache != CacheRebuild || job->ktx2Path.empty() || (job->nrChannels != 3 && job->nrChannels != 4)) return;
+
+	Ktx2Image ktx;
+	ktx.vkFormat = job->nrChannels == 4 ? KTX2_VK_FORMAT_R8G8B8A8_UNORM : KTX2_VK_FORMAT_R8G8B8_UNORM;
+	ktx.width = job->width;
+	ktx.height = job->height;
+	ktx.layers = job->layerPaths.empty() ? 0 : (uint32_t)job->layers;
+	ktx.metadata[MIP_OPTIONS_KEY] = mipOptionsValue(job->mipOptions);
+	if (!job->layerSizes.empty()) {
+		std::ostringstream sizes;
+		for (size_t i = 0; i < job->layerSizes.size(); i++)
+			sizes << (i ? " " : "") << job->layerSizes[i];
+		ktx.metadata[KTX2_KEY_LAYER_SIZES] = sizes.str();
+	}
+	for (size_t level = 0; level < job->levelOffsets.size(); level++) {
+		const unsigned char* begin = job->levelData.data() + job->levelOffsets[level];
+		ktx.levels.push_back(std::vector<unsigned char>(begin, begin + job->levelSizes[level]));
+	}
+	if (!writeKtx2(job->ktx2Path, ktx))
+		std::cout << "Failed to write texture cache " << job->ktx2Path << std::endl;
+}
+
+// results arrive a frame or two after the fence, each query is read once it will not block
+void TextureLoader::collectTimers() {
+	for (size_t i = 0; i < pendingTimers.size();) {
+		PendingTimer& timer = pendingTimers[i];
+		GLuint available = 0;
+		glGetQueryObjectuiv(timer.query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			i++;
+			continue;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(timer.query, GL_QUERY_RESULT, &nanoseconds);
+		glDeleteQueries(1, &timer.query);
+		UploadStats& target = timer.compressed ? compressedStats : stats;
+		target.uploads++;
+		target.megapixels += timer.megapixels;
+		target.gpuMilliseconds += nanoseconds / 1e6;
+		target.copyMilliseconds += timer.copyMilliseconds;
+		pendingTimers[i] = pendingTimers.back();
+		pendingTimers.pop_back();
+	}
+}
+
+void TextureLoader::update() {
+	unsigned uploadsStarted = 0;
+	collectTimers();
+
+	for (size_t i = 0; i < jobs.size();) {
+		Job& job = *jobs[i];
+		bool finished = false;
+
+		switch (job.state) {
+		case Failed:
+			std::cout << "Failed to load texture " << job.path << std::endl;
+			if (job.generation > job.slot->failed) job.slot->failed = job.generation;
+			finished = true;
+			break;
+
+		case Decoded:
+			if (isStale(job)) {
+				releasePixels(job);
+				finished = true;
+			}
+			else if (uploadsStarted < maxUploadsPerFrame) {
+				beginUpload(job);
+				if (job.state == Copying) uploadsStarted++;
+			}
+			break;
+
+		case Copied: {
+			StagingBuffer& staging = stagingPool[job.staging];
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			job.mapped = nullptr;
+
+			GLenum target = job.layerPaths.empty() ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+			GLint levels = (GLint)job.levelOffsets.size();
+			glGenTextures(1, &job.texture);
+			glBindTexture(target, job.texture);
+			glTexParameteri(target, GL_TEXTURE_WRAP_S, job.slot->wrapS);
+			glTexParameteri(target, GL_TEXTURE_WRAP_T, job.slot->wrapT);
+			glTexParameteri(target, GL_TEXTURE_MIN_FILTER, job.slot->minFilter);
+			glTexParameteri(target, GL_TEXTURE_MAG_FILTER, job.slot->magFilter);
+			glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+			if (!job.compressedFormat) applyChannelSwizzle(target, job.nrChannels);
+
+			glGenQueries(1, &job.timer);
+			glBeginQuery(GL_TIME_ELAPSED, job.timer);
+			const UploadFormat& upload = job.upload;
+			for (GLint level = 0; level < levels; level++) {
+				GLsizei w = job.width >> level > 0 ? job.width >> level : 1;
+				GLsizei h = job.height >> level > 0 ? job.height >> level : 1;
+				job.megapixels += (double)w * h * job.layers / 1e6;
+				// data pointer is an offset into the bound PBO, the driver copies asynchronously
+				size_t levelOffset = job.levelOffsets[level];
+				if (upload.expand) levelOffset = levelOffset / job.nrChannels * 4;
+				void* offset = (void*)levelOffset;
+				GLsizei size = (GLsizei)job.levelSizes[level];
+
+				if (job.compressedFormat && target == GL_TEXTURE_2D_ARRAY)
+					glCompressedTexImage3D(target, level, job.compressedFormat, w, h, job.layers, 0, size, offset);
+				else if (job.compressedFormat)
+					glCompressedTexImage2D(target, level, job.compressedFormat, w, h, 0, size, offset);
+				else {
+					// levels are tightly packed, pick the widest alignment the row size allows
+					glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment((size_t)w * upload.bytesPerPixel));
+					if (target == GL_TEXTURE_2D_ARRAY)
+						glTexImage3D(target, level, upload.internalFormat, w, h, job.layers, 0, upload.format, upload.type, offset);
+					else
+						glTexImage2D(target, level, upload.internalFormat, w, h, 0, upload.format, upload.type, offset);
+				}
+			}
+			glEndQuery(GL_TIME_ELAPSED);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			job.state = Uploading;
+			break;
+		}
+
+		case Uploading: {
+			GLenum result = glClientWaitSync(job.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+				glDeleteSync(job.fence);
+				job.fence = 0;
+				stagingPool[job.staging].inUse = false;
+				job.staging = -1;
+
+				// the query result can lag behind the fence, it is counted when it arrives
+				PendingTimer timer;
+				timer.query = job.timer;
+				timer.megapixels = job.megapixels;
+				timer.copyMilliseconds = job.copyMilliseconds;
+				timer.compressed = job.compressedFormat != 0;
+				pendingTimers.push_back(timer);
+				job.timer = 0;
+
+				if (isStale(job)) {
+					glDeleteTextures(1, &job.texture);
+				}
+				else {
+					// swap in the new texture
+					TextureSlot& slot = *job.slot;
+					if (slot.texture) glDeleteTextures(1, &slot.texture);
+					slot.texture = job.texture;
+					slot.target = job.layerPaths.empty() ? GL_TEXTURE_2D : GL_TEXTURE_2D_ARRAY;
+					slot.width = job.width;
+					slot.height = job.height;
+					slot.nrChannels = job.nrChannels;
+					slot.layers = job.layers;
+					slot.layerScale.assign(2 * job.layers, 1.0f);
+					for (size_t i = 0; i + 1 < job.layerSizes.size(); i += 2) {
+						slot.layerScale[i] = (float)job.layerSizes[i] / job.width;
+						slot.layerScale[i + 1] = (float)job.layerSizes[i + 1] / job.height;
+					}
+					slot.internalFormat = job.compressedFormat ? job.compressedFormat : job.upload.internalFormat;
+					slot.levels = (GLint)job.levelOffsets.size();
+					slot.thumbnail.swap(job.thumbnail);
+					slot.thumbnailWidth = job.thumbnailWidth;
+					slot.thumbnailHeight = job.thumbnailHeight;
+					slot.loaded = job.generation;
+				}
+				job.texture = 0;
+				finished = true;
+			}
+			break;
+		}
+
+		default:	// Decoding / Copying - a worker owns the job
+			break;
+		}
+
+		if (finished) jobs.erase(jobs.begin() + i);
+		else i++;
+	}
+}
+
+void TextureLoader::shutdown() {
+	for (std::unique_ptr<Job>& job : jobs) {
+		while (job->state == Decoding || job->state == Copying)
+			std::this_thread::yield();
+		if (job->state == Copied) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingPool[job->staging].pbo);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		if (job->fence) glDeleteSync(job->fence);
+		if (job->timer) glDeleteQueries(1, &job->timer);
+		if (job->texture) glDeleteTextures(1, &job->texture);
+		releasePixels(*job);
+	}
+	jobs.clear();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// whatever has arrived is still counted for printUploadStats()
+	collectTimers();
+	for (PendingTimer& timer : pendingTimers)
+		glDeleteQueries(1, &timer.query);
+	pendingTimers.clear();
+
+	for (StagingBuffer& staging : stagingPool)
+		glDeleteBuffers(1, &staging.pbo);
+	stagingPool.clear();
+}
+
+int TextureLoader::acquireStaging(size_t bytes) {
+	// smallest free buffer that already fits
+	int best = -1;
+	for (size_t i = 0; i < stagingPool.size(); i++) {
+		const StagingBuffer& staging = stagingPool[i];
+		if (!staging.inUse && staging.capacity >= bytes && (best < 0 || staging.capacity < stagingPool[best].capacity))
+			best = (int)i;
+	}
+	if (best >= 0) return best;
+
+	// otherwise grow a free one, or create a new one while the pool has room
+	for (size_t i = 0; i < stagingPool.size(); i++)
+		if (!stagingPool[i].inUse) best = (int)i;
+	if (best < 0) {
+		if (stagingPool.size() >= maxStagingBuffers) return -1;
+		stagingPool.push_back(StagingBuffer());
+		best = (int)stagingPool.size() - 1;
+		glGenBuffers(1, &stagingPool[best].pbo);
+	}
+
+	StagingBuffer& staging = stagingPool[best];
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.pbo);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	staging.capacity = bytes;
+	return best;
+}
+
+void TextureLoader::beginUpload(Job& job) {
+	// BGRA expansion grows every texel to 4 bytes, levels stay back to back
+	if (!job.compressedFormat) job.upload = negotiateUploadFormat(job.nrChannels, job.slot->expandToBGRA);
+	job.uploadBytes = job.upload.expand ? job.bytes / job.nrChannels * 4 : job.bytes;
+
+	job.staging = acquireStaging(job.uploadBytes);
+	if (job.staging < 0) return;	// all PBOs busy, try again next frame
+	job.thumbnailSize = thumbnailSize;
+
+	StagingBuffer& staging = stagingPool[job.staging];
+	staging.inUse = true;
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.pbo);
+	job.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, job.uploadBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!job.mapped) {
+		staging.inUse = false;
+		job.staging = -1;
+		return;
+	}
+
+	// the copy into driver memory is done by a worker as well
+	job.state = Copying;
+	Job* jobPtr = &job;
+	pool.enqueue([jobPtr] {
+		auto start = std::chrono::steady_clock::now();
+		if (jobPtr->upload.expand)
+			expandToBGRA8(jobPtr->levelData.data(), jobPtr->nrChannels, jobPtr->bytes / jobPtr->nrChannels, (unsigned char*)jobPtr->mapped);
+		else
+			memcpy(jobPtr->mapped, jobPtr->levelData.data(), jobPtr->bytes);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		jobPtr->copyMilliseconds = elapsed.count();
+		keepThumbnail(*jobPtr);
+		releasePixels(*jobPtr);
+		jobPtr->state = Copied;
+	});
+}
+
+void TextureLoader::printUploadStats() const {
+	const char* names[2] = { "uncompressed", "S3TC" };
+	const UploadStats* all[2] = { &stats, &compressedStats };
+	for (int i = 0; i < 2; i++) {
+		const UploadStats& s = *all[i];
+		if (s.megapixels <= 0.0) continue;
+		std::cout << "Texture uploads (" << names[i] << "): " << s.uploads << ", " << s.megapixels << " MP, GPU "
+			<< s.gpuMilliseconds / s.megapixels << " ms/MP, PBO fill "
+			<< s.copyMilliseconds / s.megapixels << " ms/MP" << std::endl;
+	}
+}
+
+bool TextureLoader::isStale(const Job& job) const {
+	return job.generation != job.slot->requested;
+}
+
+void TextureLoader::keepThumbnail(Job& job) {
+	std::vector<unsigned char>().swap(job.thumbnail);
+	if (job.thumbnailSize <= 0) return;
+	for (size_t level = 0; level < job.levelOffsets.size(); level++) {
+		GLint w = job.width >> level > 0 ? job.width >> level : 1;
+		GLint h = job.height >> level > 0 ? job.height >> level : 1;
+		if (w > job.thumbnailSize || h > job.thumbnailSize) continue;
+
+		const unsigned char* begin = job.levelData.data() + job.levelOffsets[level];
+		job.thumbnail.assign(begin, begin + job.levelSizes[level]);
+		job.thumbnailWidth = w;
+		job.thumbnailHeight = h;
+		return;
+	}
+}
+
+void TextureLoader::releasePixels(Job& job) {
+	std::vector<unsigned char>().swap(job.levelData);
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MipGenerator.h"
+#include "PixelFormat.h"
+#include "ThreadPool.h"
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+/*
+	Asynchronous texture loading service,
+		HOW TO USE IT:
+	* keep a TextureSlot for every texture the scene draws with and bind slot.texture
+	* load(slot, path) returns immediately, stbi_load runs on the worker threads
+	* call update() once per frame on the GL thread, it moves the pipeline forward:
+		decoded -> copied into a mapped pixel buffer (worker) -> glTexImage2D from the PBO -> fence
+	* the slot keeps showing its old texture until the new upload's fence signals; a load that
+	  fails (missing file, decode error) is reported once and leaves slot.failed = its generation
+	* loadArray(slot, paths) packs several images into one GL_TEXTURE_2D_ARRAY (RGBA8, one layer
+	  per path in the given order), switching images is then a uniform write of the layer index
+	  instead of a new upload; layers are as large as the largest image, a smaller one sits at
+	  texel (0, 0) without resampling and its edge is repeated into the padding, so sample it with
+	  uv * vec2(slot.layerScale[2 * layer], slot.layerScale[2 * layer + 1])
+	* mip levels are built on the workers (MipGenerator.h, slot.mipOptions), never with
+	  glGenerateMipmap, and every level is uploaded from the same PBO
+	* KTX2 files act as the binary texture cache: load("cat.jpg") looks for "cat.ktx2" first,
+	  loadArray takes the KTX2 path explicitly; a cache that is missing, older than the source,
+	  unreadable or built with other mipOptions (kept in its key/value data) is rewritten
+	  (RGB8/RGBA8 + mips) by the worker after decoding, so the next run only uploads
+	* block-compressed KTX2 files (see TextureCompressor.h) are used as they are, with the mip
+	  options they were compressed with, when the driver lists the S3TC formats; without S3TC
+	  the sources are decoded and the file is left alone
+	* 8-bit images get a sized internal format and a matching unpack alignment (PixelFormat.h);
+	  with slot.expandToBGRA the copy worker writes RGB/RGBA as BGRA straight into the PBO
+	* every upload is timed with a GL_TIME_ELAPSED query, kept until its result is available and
+	  only then counted; uploadStats(compressed) / printUploadStats() give the GPU time per
+	  megapixel separately for uncompressed and S3TC uploads
+	* thumbnailSize > 0 keeps the largest mip level of at most that many texels per side in
+	  slot.thumbnail when an upload finishes (TextureBudget uses it to build thumbnails without
+	  reading the texture back)
+	* call shutdown() before glfwTerminate(), it frees the staging PBOs and pending textures
+*/
+struct TextureSlot
+{
+	GLuint texture = 0;		// 0 until the first upload finishes
+	GLenum target = GL_TEXTURE_2D;
+	GLint width = 0, height = 0, nrChannels = 0;
+	GLint layers = 1;
+	std::vector<float> layerScale;	// u, v per layer: the part of the layer its image covers
+	GLenum internalFormat = 0;	// GL_R8 .. GL_RGBA8 or one of the S3TC formats
+	GLint levels = 0;
+
+	GLint wrapS = GL_REPEAT, wrapT = GL_REPEAT;
+	GLint minFilter = GL_NEAREST, magFilter = GL_NEAREST;
+	MipOptions mipOptions;
+	bool expandToBGRA = true;
+
+	unsigned requested = 0;	// generation of the newest load() call
+	unsigned loaded = 0;	// generation currently shown in texture
+	unsigned failed = 0;	// generation of the newest load() that could not be decoded
+
+	// with TextureLoader::thumbnailSize set: the largest mip level that fits in it, kept on the
+	// CPU in the upload's source layout (S3TC blocks or nrChannels bytes per texel, all layers)
+	std::vector<unsigned char> thumbnail;
+	GLint thumbnailWidth = 0, thumbnailHeight = 0;
+};
+
+struct UploadStats
+{
+	unsigned uploads = 0;
+	double megapixels = 0.0;		// texels of every level and layer of the timed uploads
+	double gpuMilliseconds = 0.0;	// GL_TIME_ELAPSED around the glTexImage calls
+	double copyMilliseconds = 0.0;	// PBO fill on the workers, including the BGRA expansion
+};
+
+class TextureLoader
+{
+public:
+	explicit TextureLoader(unsigned threadCount = 0, unsigned stagingBuffers = 2);
+	~TextureLoader();
+
+	void load(TextureSlot& slot, const std::string& path);
+	void loadArray(TextureSlot& slot, const std::vector<std::string>& paths, const std::string& ktx2Path = "");
+	void update();
+	void shutdown();
+
+	bool busy() const { return !jobs.empty(); }
+	bool supportsBC1() const { return hasBC1; }
+	bool supportsBC3() const { return hasBC3; }
+	const UploadStats& uploadStats(bool compressed = false) const { return compressed ? compressedStats : stats; }
+	void printUploadStats() const;
+
+	unsigned maxUploadsPerFrame = 1;
+	int thumbnailSize = 0;
+
+private:
+	enum JobState { Decoding, Decoded, Copying, Copied, Uploading, Failed };
+	// what the worker found in the KTX2 cache, writeCache replaces it only on CacheRebuild
+	enum CacheState { CacheLoaded, CacheRebuild, CacheKeep };
+
+	struct StagingBuffer
+	{
+		GLuint pbo = 0;
+		size_t capacity = 0;
+		bool inUse = false;
+	};
+
+	struct Job
+	{
+		TextureSlot* slot = nullptr;
+		unsigned generation = 0;
+		std::string path;
+		std::vector<std::string> layerPaths;	// non-empty for array jobs
+		std::string ktx2Path;
+		MipOptions mipOptions;
+		CacheState cache = CacheRebuild;
+		std::atomic<int> state{ Decoding };
+
+		// every mip level back to back, each level holds all layers
+		std::vector<unsigned char> levelData;
+		std::vector<size_t> levelOffsets, levelSizes;
+		GLint width = 0, height = 0, nrChannels = 0, layers = 1;
+		std::vector<int> layerSizes;	// width, height of every layer's image inside the padded layer
+		size_t bytes = 0;
+		GLenum compressedFormat = 0;
+
+		UploadFormat upload;
+		size_t uploadBytes = 0;
+		double copyMilliseconds = 0.0;
+		int thumbnailSize = 0;
+		std::vector<unsigned char> thumbnail;
+		GLint thumbnailWidth = 0, thumbnailHeight = 0;
+
+		int staging = -1;
+		void* mapped = nullptr;
+		GLuint texture = 0;
+		GLsync fence = 0;
+		GLuint timer = 0;
+		double megapixels = 0.0;
+	};
+
+	// an upload whose texture is done but whose GL_TIME_ELAPSED result may still be on its way
+	struct PendingTimer
+	{
+		GLuint query = 0;
+		double megapixels = 0.0;
+		double copyMilliseconds = 0.0;
+		bool compressed = false;
+	};
+
+	ThreadPool pool;
+	std::vector<std::unique_ptr<Job>> jobs;
+	std::vector<StagingBuffer> stagingPool;
+	unsigned maxStagingBuffers;
+	bool hasBC1 = false, hasBC3 = false;
+	UploadStats stats, compressedStats;
+	std::vector<PendingTimer> pendingTimers;
+
+	CacheState loadKtx2(Job* job);
+	static void decodeImage(Job* job);
+	static void decodeLayers(Job* job);
+	static void packLevels(Job* job, const std::vector<std::vector<std::vector<unsigned char>>>& layerMips);
+	static void writeCache(const Job* job);
+	static void keepThumbnail(Job& job);
+	static void releasePixels(Job& job);
+
+	int acquireStaging(size_t bytes);
+	void collectTimers();
+	void beginUpload(Job& job);
+	bool isStale(const Job& job) const;
+};
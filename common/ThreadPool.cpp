@@ -0,0 +1,70 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+	if (threadCount == 0) {
+		unsigned hw = std::thread::hardware_concurrency();
+		threadCount = hw > 1 ? hw - 1 : 1;
+	}
+	for (unsigned i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	condition.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push(std::move(job));
+	}
+	condition.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body) {
+	if (count == 0) return;
+
+	// one chunk per worker plus one for the caller
+	size_t chunks = workers.size() + 1;
+	if (chunks > count) chunks = count;
+	size_t chunkSize = (count + chunks - 1) / chunks;
+
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+	size_t remaining = chunks - 1;
+
+	for (size_t c = 1; c < chunks; c++) {
+		size_t begin = c * chunkSize;
+		size_t end = begin + chunkSize < count ? begin + chunkSize : count;
+		enqueue([&, begin, end] {
+			if (begin < end) body(begin, end);
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (--remaining == 0) doneCondition.notify_one();
+		});
+	}
+
+	body(0, chunkSize < count ? chunkSize : count);
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&] { return remaining == 0; });
+}
+
+void ThreadPool::workerLoop() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping && jobs.empty()) return;
+			job = std::move(jobs.front());
+			jobs.pop();
+		}
+		job();
+	}
+}
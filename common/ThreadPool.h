@@ -0,0 +1,35 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+/*
+	Simple worker pool shared by the labs,
+		HOW TO USE IT:
+	* create one pool per program (threadCount = 0 -> hardware_concurrency - 1)
+	* enqueue() jobs that never touch OpenGL, the GL context lives on the main thread only
+	* parallelFor(count, body) splits [0, count) into chunks, runs them on the workers and on
+	  the calling thread and returns when all are done (do not call it from inside a job)
+	* the destructor finishes queued jobs and joins the workers
+*/
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned threadCount = 0);
+	~ThreadPool();
+
+	void enqueue(std::function<void()> job);
+	void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body);
+	unsigned size() const { return (unsigned)workers.size(); }
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	void workerLoop();
+};
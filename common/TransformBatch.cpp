@@ -0,0 +1,157 @@
+#include "TransformBatch.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRANSFORM_AVX2 1
+#endif
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TRANSFORM_SSE2 1
+#endif
+
+void TransformBatch::resize(size_t count) {
+	tx.resize(count, 0.0f);
+	ty.resize(count, 0.0f);
+	tz.resize(count, 0.0f);
+	qx.resize(count, 0.0f);
+	qy.resize(count, 0.0f);
+	qz.resize(count, 0.0f);
+	qw.resize(count, 1.0f);
+	sx.resize(count, 1.0f);
+	sy.resize(count, 1.0f);
+	sz.resize(count, 1.0f);
+}
+
+void TransformBatch::setRotationZ(size_t i, float angle) {
+	qx[i] = 0.0f;
+	qy[i] = 0.0f;
+	qz[i] = std::sin(angle * 0.5f);
+	qw[i] = std::cos(angle * 0.5f);
+}
+
+const char* TransformBatch::composePath() {
+#if defined(TRANSFORM_AVX2)
+	return "AVX2";
+#elif defined(TRANSFORM_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
+// the rotation part is the quaternion matrix with every column scaled (R * S), the fourth
+// column is the translation; x2 = 2x etc. keep it to one multiply per term like glm::mat4_cast
+void TransformBatch::compose(float* matrices, size_t first, size_t count) const {
+	size_t i = first, end = first + count;
+
+#ifdef TRANSFORM_AVX2
+	{
+		const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+		for (; i + 8 <= end; i += 8) {
+			__m256 x = _mm256_loadu_ps(&qx[i]), y = _mm256_loadu_ps(&qy[i]);
+			__m256 z = _mm256_loadu_ps(&qz[i]), w = _mm256_loadu_ps(&qw[i]);
+			__m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+			__m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+			__m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+			__m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+			__m256 scaleX = _mm256_loadu_ps(&sx[i]), scaleY = _mm256_loadu_ps(&sy[i]), scaleZ = _mm256_loadu_ps(&sz[i]);
+
+			// rows[column][row], 8 objects per register
+			__m256 rows[4][4] = {
+				{ _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), scaleX),
+				  _mm256_mul_ps(_mm256_add_ps(xy, wz), scaleX),
+				  _mm256_mul_ps(_mm256_sub_ps(xz, wy), scaleX), zero },
+				{ _mm256_mul_ps(_mm256_sub_ps(xy, wz), scaleY),
+				  _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), scaleY),
+				  _mm256_mul_ps(_mm256_add_ps(yz, wx), scaleY), zero },
+				{ _mm256_mul_ps(_mm256_add_ps(xz, wy), scaleZ),
+				  _mm256_mul_ps(_mm256_sub_ps(yz, wx), scaleZ),
+				  _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), scaleZ), zero },
+				{ _mm256_loadu_ps(&tx[i]), _mm256_loadu_ps(&ty[i]), _mm256_loadu_ps(&tz[i]), one },
+			};
+
+			// 4x4 transpose inside each 128-bit half: the low half holds objects i..i+3, the high i+4..i+7
+			float* out = matrices + 16 * i;
+			for (int c = 0; c < 4; c++) {
+				__m256 t0 = _mm256_unpacklo_ps(rows[c][0], rows[c][1]);
+				__m256 t1 = _mm256_unpackhi_ps(rows[c][0], rows[c][1]);
+				__m256 t2 = _mm256_unpacklo_ps(rows[c][2], rows[c][3]);
+				__m256 t3 = _mm256_unpackhi_ps(rows[c][2], rows[c][3]);
+				__m256 o[4] = {
+					_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+					_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+					_mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+				};
+				for (int k = 0; k < 4; k++) {
+					_mm_storeu_ps(out + 16 * k + 4 * c, _mm256_castps256_ps128(o[k]));
+					_mm_storeu_ps(out + 16 * (k + 4) + 4 * c, _mm256_extractf128_ps(o[k], 1));
+				}
+			}
+		}
+	}
+#endif
+
+#ifdef TRANSFORM_SSE2
+	{
+		const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4) {
+			__m128 x = _mm_loadu_ps(&qx[i]), y = _mm_loadu_ps(&qy[i]);
+			__m128 z = _mm_loadu_ps(&qz[i]), w = _mm_loadu_ps(&qw[i]);
+			__m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+			__m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+			__m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+			__m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+			__m128 scaleX = _mm_loadu_ps(&sx[i]), scaleY = _mm_loadu_ps(&sy[i]), scaleZ = _mm_loadu_ps(&sz[i]);
+
+			__m128 rows[4][4] = {
+				{ _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), scaleX),
+				  _mm_mul_ps(_mm_add_ps(xy, wz), scaleX),
+				  _mm_mul_ps(_mm_sub_ps(xz, wy), scaleX), zero },
+				{ _mm_mul_ps(_mm_sub_ps(xy, wz), scaleY),
+				  _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), scaleY),
+				  _mm_mul_ps(_mm_add_ps(yz, wx), scaleY), zero },
+				{ _mm_mul_ps(_mm_add_ps(xz, wy), scaleZ),
+				  _mm_mul_ps(_mm_sub_ps(yz, wx), scaleZ),
+				  _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), scaleZ), zero },
+				{ _mm_loadu_ps(&tx[i]), _mm_loadu_ps(&ty[i]), _mm_loadu_ps(&tz[i]), one },
+			};
+
+			float* out = matrices + 16 * i;
+			for (int c = 0; c < 4; c++) {
+				_MM_TRANSPOSE4_PS(rows[c][0], rows[c][1], rows[c][2], rows[c][3]);
+				for (int k = 0; k < 4; k++)
+					_mm_storeu_ps(out + 16 * k + 4 * c, rows[c][k]);
+			}
+		}
+	}
+#endif
+
+	for (; i < end; i++) {
+		float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+		float x2 = x + x, y2 = y + y, z2 = z + z;
+		float xx = x * x2, yy = y * y2, zz = z * z2;
+		float xy = x * y2, xz = x * z2, yz = y * z2;
+		float wx = w * x2, wy = w * y2, wz = w * z2;
+
+		float* m = matrices + 16 * i;
+		m[0] = (1.0f - (yy + zz)) * sx[i];
+		m[1] = (xy + wz) * sx[i];
+		m[2] = (xz - wy) * sx[i];
+		m[3] = 0.0f;
+		m[4] = (xy - wz) * sy[i];
+		m[5] = (1.0f - (xx + zz)) * sy[i];
+		m[6] = (yz + wx) * sy[i];
+		m[7] = 0.0f;
+		m[8] = (xz + wy) * sz[i];
+		m[9] = (yz - wx) * sz[i];
+		m[10] = (1.0f - (xx + yy)) * sz[i];
+		m[11] = 0.0f;
+		m[12] = tx[i];
+		m[13] = ty[i];
+		m[14] = tz[i];
+		m[15] = 1.0f;
+	}
+}
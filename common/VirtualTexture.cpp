@@ -0,0 +1,722 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#include <stb_image.h>
+
+#include "MipGenerator.h"
+
+static const char VTEX_MAGIC[4] = { 'V', 'T', 'E', 'X' };
+static const size_t VTEX_HEADER_BYTES = 4 + 5 * 4;
+static const int SLOT_SIZE = VirtualTexture::PAGE_SIZE + 2 * VirtualTexture::PAGE_BORDER;
+
+const char* VirtualTexture::glslSource =
+"uniform sampler2D uVtPhysical;\n"
+"uniform usampler2D uVtIndirection;\n"
+"uniform vec2 uVtSize;\n"				// level 0 size in texels
+"uniform vec2 uVtPhysicalSize;\n"
+"uniform float uVtPageSize;\n"
+"uniform float uVtBorder;\n"
+"uniform float uVtMaxLevel;\n"
+"uniform float uVtLodBias;\n"
+"float vtLevel(vec2 uv) {\n"
+"   vec2 dx = dFdx(uv * uVtSize), dy = dFdy(uv * uVtSize);\n"
+"   float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + uVtLodBias;\n"
+"   return clamp(floor(lod), 0.0, uVtMaxLevel);\n"
+"}\n"
+"vec2 vtLevelSize(float level) {\n"
+"   return max(floor(uVtSize / exp2(level)), vec2(1.0));\n"
+"}\n"
+"ivec2 vtPage(vec2 uv, float level) {\n"
+"   vec2 levelSize = vtLevelSize(level);\n"
+"   return ivec2(min(floor(uv * levelSize / uVtPageSize), ceil(levelSize / uVtPageSize) - 1.0));\n"
+"}\n"
+"vec4 sampleVirtual(vec2 uv) {\n"
+"   float level = vtLevel(uv);\n"
+"   uv = clamp(uv, 0.0, 1.0);\n"
+"   uvec4 entry = texelFetch(uVtIndirection, vtPage(uv, level), int(level));\n"	// slot x, slot y, resident level
+"   float resident = float(entry.z);\n"
+"   vec2 inPage = uv * vtLevelSize(resident) - vec2(vtPage(uv, resident)) * uVtPageSize;\n"
+"   vec2 texel = vec2(entry.xy) * (uVtPageSize + 2.0 * uVtBorder) + uVtBorder + inPage;\n"
+"   return textureLod(uVtPhysical, texel / uVtPhysicalSize, 0.0);\n"
+"}\n"
+"uvec4 virtualFeedback(vec2 uv) {\n"
+"   float level = vtLevel(uv);\n"
+"   return uvec4(uvec2(vtPage(clamp(uv, 0.0, 1.0), level)), uint(level), 1u);\n"
+"}\n";
+
+static int pagesFor(int size) {
+	return (size + VirtualTexture::PAGE_SIZE - 1) / VirtualTexture::PAGE_SIZE;
+}
+
+// levels down to the first one that fits in a single page
+static int virtualLevelCount(int width, int height) {
+	int levels = 1;
+	while (pagesFor(width) > 1 || pagesFor(height) > 1) {
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		levels++;
+	}
+	return levels;
+}
+
+static int nextPowerOfTwo(int value) {
+	int result = 1;
+	while (result < value) result *= 2;
+	return result;
+}
+
+static void put32(std::ostream& file, uint32_t value) {
+	unsigned char bytes[4] = { (unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+	file.write((const char*)bytes, 4);
+}
+
+static uint32_t get32(const unsigned char* p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const size_t PAGE_BYTES = (size_t)SLOT_SIZE * SLOT_SIZE * 4;
+
+// one page with its border out of a band of SLOT_SIZE level rows, texels past the sides repeat the edge
+static void copyPage(const unsigned char* band, int width, int pageX, unsigned char* out) {
+	int originX = pageX * VirtualTexture::PAGE_SIZE - VirtualTexture::PAGE_BORDER;
+	for (int y = 0; y < SLOT_SIZE; y++) {
+		const unsigned char* row = band + (size_t)y * width * 4;
+		for (int x = 0; x < SLOT_SIZE; x++) {
+			int sx = std::min(std::max(originX + x, 0), width - 1);
+			memcpy(out + ((size_t)y * SLOT_SIZE + x) * 4, row + (size_t)sx * 4, 4);
+		}
+	}
+}
+
+// level 0 rows of a grid of equally sized images (row-major), only the tile rows the current band
+// reaches are decoded, memory follows the mosaic's width and not its area
+class MosaicRows
+{
+public:
+	MosaicRows(const std::vector<std::string>& tiles, int columns, ThreadPool& pool)
+		: tiles(tiles), columns(columns), pool(pool) {
+	}
+
+	bool open() {
+		if (columns < 1 || tiles.empty() || tiles.size() % columns != 0) {
+			std::cout << "A mosaic of " << columns << " columns needs a multiple of " << columns << " tiles" << std::endl;
+			return false;
+		}
+		int channels;
+		if (!stbi_info(tiles[0].c_str(), &tileWidth, &tileHeight, &channels)) {
+			std::cout << "Failed to load texture " << tiles[0] << std::endl;
+			return false;
+		}
+		width = tileWidth * columns;
+		height = tileHeight * (int)(tiles.size() / columns);
+		return true;
+	}
+
+	const unsigned char* row(int y) {
+		int tileRow = y / tileHeight;
+		// a band starts at most SLOT_SIZE rows above the last row asked for
+		for (std::map<int, std::vector<unsigned char>>::iterator it = decoded.begin(); it != decoded.end();) {
+			if ((it->first + 1) * tileHeight <= y - SLOT_SIZE) it = decoded.erase(it);
+			else ++it;
+		}
+		std::map<int, std::vector<unsigned char>>::iterator found = decoded.find(tileRow);
+		if (found == decoded.end()) {
+			found = decoded.emplace(tileRow, std::vector<unsigned char>((size_t)width * tileHeight * 4)).first;
+			if (!decode(tileRow, found->second)) return nullptr;
+		}
+		return found->second.data() + ((size_t)(y % tileHeight) * width) * 4;
+	}
+
+	int width = 0, height = 0;
+
+private:
+	bool decode(int tileRow, std::vector<unsigned char>& rows) {
+		std::atomic<bool> failed{ false };
+		pool.parallelFor(columns, [&](size_t begin, size_t end) {
+			for (size_t column = begin; column < end; column++) {
+				const std::string& tilePath = tiles[tileRow * columns + column];
+				int w, h, channels;
+				unsigned char* pixels = stbi_load(tilePath.c_str(), &w, &h, &channels, 4);
+				if (!pixels || w != tileWidth || h != tileHeight) {
+					std::cout << "Failed to load texture " << tilePath << std::endl;
+					failed = true;
+				}
+				else {
+					for (int y = 0; y < tileHeight; y++)
+						memcpy(rows.data() + ((size_t)y * width + column * tileWidth) * 4, pixels + (size_t)y * tileWidth * 4, (size_t)tileWidth * 4);
+				}
+				if (pixels) stbi_image_free(pixels);
+			}
+		});
+		return !failed;
+	}
+
+	const std::vector<std::string>& tiles;
+	int columns;
+	ThreadPool& pool;
+	int tileWidth = 0, tileHeight = 0;
+	std::map<int, std::vector<unsigned char>> decoded;	// tile row -> its rows at the mosaic's width
+};
+
+// rows of a level that is already in the file, read back one row of pages at a time
+class PageRows
+{
+public:
+	PageRows(std::fstream& file, uint64_t firstPage, int width, int height)
+		: file(file), firstPage(firstPage), width(width), height(height), pagesX(pagesFor(width)), assembled((size_t)width * 4) {
+	}
+
+	const unsigned char* row(int y) {
+		int pageRow = y / VirtualTexture::PAGE_SIZE;
+		for (std::map<int, std::vector<unsigned char>>::iterator it = cached.begin(); it != cached.end();) {
+			if (it->first < pageRow - 1) it = cached.erase(it);
+			else ++it;
+		}
+		std::map<int, std::vector<unsigned char>>::iterator found = cached.find(pageRow);
+		if (found == cached.end()) {
+			found = cached.emplace(pageRow, std::vector<unsigned char>(pagesX * PAGE_BYTES)).first;
+			file.seekg(VTEX_HEADER_BYTES + (firstPage + (uint64_t)pageRow * pagesX) * PAGE_BYTES);
+			if (!file.read((char*)found->second.data(), found->second.size())) return nullptr;
+		}
+
+		int inPage = y % VirtualTexture::PAGE_SIZE + VirtualTexture::PAGE_BORDER;
+		for (int x = 0; x < pagesX; x++) {
+			const unsigned char* page = found->second.data() + x * PAGE_BYTES;
+			int count = std::min(VirtualTexture::PAGE_SIZE, width - x * VirtualTexture::PAGE_SIZE);
+			memcpy(assembled.data() + (size_t)x * VirtualTexture::PAGE_SIZE * 4,
+				page + ((size_t)inPage * SLOT_SIZE + VirtualTexture::PAGE_BORDER) * 4, (size_t)count * 4);
+		}
+		return assembled.data();
+	}
+
+private:
+	std::fstream& file;
+	uint64_t firstPage;
+	int width, height, pagesX;
+	std::map<int, std::vector<unsigned char>> cached;	// page row -> its pages as stored
+	std::vector<unsigned char> assembled;
+};
+
+// cuts one level into pages a band at a time: the SLOT_SIZE rows one row of pages covers,
+// rows above and below the level repeat the edge
+template <typename Rows>
+static bool writeLevel(std::fstream& file, uint64_t firstPage, int levelWidth, int levelHeight, Rows rows, ThreadPool& pool) {
+	int pagesX = pagesFor(levelWidth), pagesY = pagesFor(levelHeight);
+	size_t rowBytes = (size_t)levelWidth * 4;
+	std::vector<unsigned char> band(SLOT_SIZE * rowBytes), pages(pagesX * PAGE_BYTES);
+
+	for (int y = 0; y < pagesY; y++) {
+		int originY = y * VirtualTexture::PAGE_SIZE - VirtualTexture::PAGE_BORDER;
+		for (int i = 0; i < SLOT_SIZE; i++) {
+			const unsigned char* row = rows(std::min(std::max(originY + i, 0), levelHeight - 1));
+			if (!row) return false;
+			memcpy(band.data() + i * rowBytes, row, rowBytes);
+		}
+		pool.parallelFor(pagesX, [&](size_t begin, size_t end) {
+			for (size_t x = begin; x < end; x++)
+				copyPage(band.data(), levelWidth, (int)x, pages.data() + x * PAGE_BYTES);
+		});
+		file.seekp(VTEX_HEADER_BYTES + (firstPage + (uint64_t)y * pagesX) * PAGE_BYTES);
+		file.write((const char*)pages.data(), pages.size());
+	}
+	return (bool)file;
+}
+
+bool buildVirtualTexture(const std::string& imagePath, const std::string& pagePath, ThreadPool& pool) {
+	return buildVirtualTexture(std::vector<std::string>(1, imagePath), 1, pagePath, pool);
+}
+
+bool buildVirtualTexture(const std::vector<std::string>& tilePaths, int columns, const std::string& pagePath, ThreadPool& pool) {
+	MosaicRows mosaic(tilePaths, columns, pool);
+	if (!mosaic.open()) return false;
+
+	std::fstream file(pagePath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!file) {
+		std::cout << "Failed to write " << pagePath << std::endl;
+		return false;
+	}
+
+	int width = mosaic.width, height = mosaic.height;
+	int levels = virtualLevelCount(width, height);
+	file.write(VTEX_MAGIC, 4);
+	put32(file, width);
+	put32(file, height);
+	put32(file, VirtualTexture::PAGE_SIZE);
+	put32(file, VirtualTexture::PAGE_BORDER);
+	put32(file, levels);
+
+	// pages are written level by level, row by row, so their offsets need no index; level 0 comes
+	// from the source images, every further level from the pages of the previous one in the file
+	if (!writeLevel(file, 0, width, height, [&](int y) { return mosaic.row(y); }, pool)) {
+		std::cout << "Failed to write " << pagePath << std::endl;
+		return false;
+	}
+
+	uint64_t firstPage = 0;
+	int levelWidth = width, levelHeight = height;
+	for (int l = 1; l < levels; l++) {
+		PageRows previous(file, firstPage, levelWidth, levelHeight);
+		firstPage += (uint64_t)pagesFor(levelWidth) * pagesFor(levelHeight);
+		int previousWidth = levelWidth, previousHeight = levelHeight;
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+
+		// row y of the level is the 2x2 box of rows 2y and 2y+1 above, like downsample() on the whole level
+		size_t previousRowBytes = (size_t)previousWidth * 4;
+		std::vector<unsigned char> pair(2 * previousRowBytes), half((size_t)levelWidth * 4);
+		auto rows = [&](int y) -> const unsigned char* {
+			for (int i = 0; i < 2; i++) {
+				const unsigned char* row = previous.row(std::min(2 * y + i, previousHeight - 1));
+				if (!row) return nullptr;
+				memcpy(pair.data() + i * previousRowBytes, row, previousRowBytes);
+			}
+			downsample(pair.data(), previousWidth, 2, 4, half.data(), true);
+			return half.data();
+		};
+		if (!writeLevel(file, firstPage, levelWidth, levelHeight, rows, pool)) {
+			std::cout << "Failed to write " << pagePath << std::endl;
+			return false;
+		}
+	}
+	return (bool)file;
+}
+
+VirtualTexture::VirtualTexture(unsigned threadCount)
+	: pool(threadCount) {
+}
+
+VirtualTexture::~VirtualTexture() {
+	// GL objects must already be gone (close()), only the workers are waited for here
+	for (std::unique_ptr<PageLoad>& load : loads)
+		while (load->state == Loading)
+			std::this_thread::yield();
+}
+
+uint64_t VirtualTexture::pageKey(int level, int x, int y) {
+	return ((uint64_t)level << 56) | ((uint64_t)y << 28) | (uint64_t)x;
+}
+
+size_t VirtualTexture::pageBytes() const {
+	return PAGE_BYTES;
+}
+
+bool VirtualTexture::open(const std::string& pagePath, int slotsPerAxis, int divisor) {
+	close();
+
+	std::ifstream file(pagePath, std::ios::binary);
+	unsigned char header[VTEX_HEADER_BYTES];
+	if (!file.read((char*)header, VTEX_HEADER_BYTES) || memcmp(header, VTEX_MAGIC, 4) != 0
+		|| get32(header + 12) != PAGE_SIZE || get32(header + 16) != PAGE_BORDER)
+		return false;
+
+	path = pagePath;
+	width = get32(header + 4);
+	height = get32(header + 8);
+	levels = get32(header + 20);
+	dataOffset = VTEX_HEADER_BYTES;
+
+	uint64_t firstPage = 0;
+	int levelWidth = width, levelHeight = height;
+	for (int l = 0; l < levels; l++) {
+		pagesX.push_back(pagesFor(levelWidth));
+		pagesY.push_back(pagesFor(levelHeight));
+		levelFirstPage.push_back(firstPage);
+		firstPage += (uint64_t)pagesX[l] * pagesY[l];
+		levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+		levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+	}
+
+	// physical page cache, its size is fixed no matter how large the image is; slot
+	// coordinates have to fit the 8-bit indirection entries
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	cacheSlots = std::max(1, std::min(std::min(slotsPerAxis, maxSize / SLOT_SIZE), 255));
+	slots.assign(cacheSlots * cacheSlots, Slot());
+	glGenTextures(1, &physical);
+	glBindTexture(GL_TEXTURE_2D, physical);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSlots * SLOT_SIZE, cacheSlots * SLOT_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// one unpack buffer per load in flight, the workers read pages straight into them
+	stagingBuffers.resize(std::max(1u, maxPendingLoads));
+	glGenBuffers((GLsizei)stagingBuffers.size(), stagingBuffers.data());
+	for (size_t i = 0; i < stagingBuffers.size(); i++) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffers[i]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, PAGE_BYTES, NULL, GL_STREAM_DRAW);
+		freeStaging.push_back((int)i);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// the coarsest page is the fallback for everything, load it now and never evict it
+	uint64_t root = pageKey(levels - 1, 0, 0);
+	int staging = -1;
+	unsigned char* pixels = mapStaging(staging);
+	bool read = pixels && readPage(root, pixels);
+	if (pixels) unmapStaging(staging);
+	if (!read) {
+		std::cout << "Failed to read " << pagePath << std::endl;
+		close();
+		return false;
+	}
+	int slot = allocateSlot();
+
+	// indirection: power of two sizes so that mip l holds every page of pyramid level l,
+	// filled once with the root page, afterwards only the texels under a changed page are written
+	tableWidth = nextPowerOfTwo(pagesX[0]);
+	tableHeight = nextPowerOfTwo(pagesY[0]);
+	const uint8_t rootEntry[4] = { (uint8_t)(slot % cacheSlots), (uint8_t)(slot / cacheSlots), (uint8_t)(levels - 1), 1 };
+	glGenTextures(1, &indirection);
+	glBindTexture(GL_TEXTURE_2D, indirection);
+	indirectionLevels.resize(levels);
+	for (int l = 0; l < levels; l++) {
+		int w = std::max(1, tableWidth >> l), h = std::max(1, tableHeight >> l);
+		std::vector<uint8_t>& table = indirectionLevels[l];
+		table.resize((size_t)w * h * 4);
+		for (size_t i = 0; i < table.size(); i += 4)
+			memcpy(&table[i], rootEntry, 4);
+		glTexImage2D(GL_TEXTURE_2D, l, GL_RGBA8UI, w, h, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, table.data());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	uploadPage(root, slot, staging);
+	slots[slot].pinned = true;
+
+	feedbackDivisor = std::max(1, divisor);
+	return true;
+}
+
+void VirtualTexture::close() {
+	for (std::unique_ptr<PageLoad>& load : loads) {
+		while (load->state == Loading)
+			std::this_thread::yield();
+		unmapStaging(load->staging);
+	}
+	loads.clear();
+
+	if (feedbackFence) glDeleteSync(feedbackFence);
+	if (feedbackPbo) glDeleteBuffers(1, &feedbackPbo);
+	if (feedbackFbo) glDeleteFramebuffers(1, &feedbackFbo);
+	if (feedbackColor) glDeleteTextures(1, &feedbackColor);
+	if (physical) glDeleteTextures(1, &physical);
+	if (indirection) glDeleteTextures(1, &indirection);
+	if (!stagingBuffers.empty()) glDeleteBuffers((GLsizei)stagingBuffers.size(), stagingBuffers.data());
+	feedbackFence = 0;
+	feedbackFrame = 0;
+	feedbackPbo = feedbackFbo = feedbackColor = physical = indirection = 0;
+	feedbackWidth = feedbackHeight = 0;
+
+	pagesX.clear();
+	pagesY.clear();
+	levelFirstPage.clear();
+	slots.clear();
+	pageSlots.clear();
+	indirectionLevels.clear();
+	stagingBuffers.clear();
+	freeStaging.clear();
+	levels = 0;
+}
+
+bool VirtualTexture::readPage(uint64_t page, unsigned char* pixels) const {
+	int level = (int)(page >> 56);
+	int y = (int)((page >> 28) & 0xFFFFFFF);
+	int x = (int)(page & 0xFFFFFFF);
+	uint64_t index = levelFirstPage[level] + (uint64_t)y * pagesX[level] + x;
+
+	// every load opens its own stream, the workers never share a file position
+	std::ifstream file(path, std::ios::binary);
+	file.seekg(dataOffset + index * pageBytes());
+	return (bool)file.read((char*)pixels, pageBytes());
+}
+
+unsigned char* VirtualTexture::mapStaging(int& staging) {
+	if (freeStaging.empty()) return nullptr;
+	// invalidating orphans the storage a previous upload may still be copying from
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffers[freeStaging.back()]);
+	unsigned char* pixels = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, PAGE_BYTES,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!pixels) return nullptr;
+	staging = freeStaging.back();
+	freeStaging.pop_back();
+	return pixels;
+}
+
+void VirtualTexture::unmapStaging(int staging) {
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffers[staging]);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	freeStaging.push_back(staging);
+}
+
+void VirtualTexture::resizeFeedback(int viewportWidth, int viewportHeight) {
+	int w = std::max(1, viewportWidth / feedbackDivisor), h = std::max(1, viewportHeight / feedbackDivisor);
+	if (w == feedbackWidth && h == feedbackHeight) return;
+
+	if (feedbackFence) {
+		glDeleteSync(feedbackFence);
+		feedbackFence = 0;
+	}
+	if (!feedbackFbo) {
+		glGenFramebuffers(1, &feedbackFbo);
+		glGenTextures(1, &feedbackColor);
+		glGenBuffers(1, &feedbackPbo);
+	}
+	feedbackWidth = w;
+	feedbackHeight = h;
+
+	glBindTexture(GL_TEXTURE_2D, feedbackColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, w, h, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackColor, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Virtual texture feedback framebuffer is incomplete" << std::endl;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)w * h * 4 * sizeof(uint16_t), NULL, GL_STREAM_READ);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTexture::beginFeedback() {
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &savedFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	resizeFeedback(savedViewport[2], savedViewport[3]);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFbo);
+	glViewport(0, 0, feedbackWidth, feedbackHeight);
+	const GLuint nothing[4] = { 0, 0, 0, 0 };	// w == 0 -> no page sampled here
+	glClearBufferuiv(GL_COLOR, 0, nothing);
+}
+
+void VirtualTexture::endFeedback() {
+	// one readback in flight at a time, a frame with the previous one still pending is skipped
+	if (!feedbackFence) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo);
+		glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		feedbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, savedFramebuffer);
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+}
+
+void VirtualTexture::readFeedback() {
+	if (!feedbackFence) return;
+	GLenum result = glClientWaitSync(feedbackFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) return;
+	glDeleteSync(feedbackFence);
+	feedbackFence = 0;
+	feedbackFrame = frame;
+
+	std::vector<uint64_t> seen;
+	size_t texels = (size_t)feedbackWidth * feedbackHeight;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackPbo);
+	const uint16_t* data = (const uint16_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, texels * 4 * sizeof(uint16_t), GL_MAP_READ_BIT);
+	if (data) {
+		for (size_t i = 0; i < texels; i++) {
+			const uint16_t* texel = data + i * 4;
+			if (texel[3] == 0 || texel[2] >= levels || texel[0] >= pagesX[texel[2]] || texel[1] >= pagesY[texel[2]])
+				continue;
+			seen.push_back(pageKey(texel[2], texel[0], texel[1]));
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	std::sort(seen.begin(), seen.end());
+	seen.erase(std::unique(seen.begin(), seen.end()), seen.end());
+
+	std::vector<uint64_t> missing;
+	for (uint64_t page : seen)
+		request((int)(page >> 56), (int)(page & 0xFFFFFFF), (int)((page >> 28) & 0xFFFFFFF), missing);
+
+	// coarse pages first, they replace the fallback for the largest area
+	std::sort(missing.begin(), missing.end(), [](uint64_t a, uint64_t b) { return a > b; });
+	missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+	for (uint64_t page : missing) {
+		if (loads.size() >= maxPendingLoads) break;
+		bool pending = false;
+		for (std::unique_ptr<PageLoad>& load : loads)
+			if (load->page == page) pending = true;
+		if (pending) continue;
+
+		// the worker reads the page straight into a mapped unpack buffer, no copy on the GL thread
+		int staging = -1;
+		unsigned char* pixels = mapStaging(staging);
+		if (!pixels) break;
+		loads.push_back(std::make_unique<PageLoad>());
+		PageLoad* load = loads.back().get();
+		load->page = page;
+		load->staging = staging;
+		load->pixels = pixels;
+		pool.enqueue([this, load] {
+			load->state = readPage(load->page, load->pixels) ? Loaded : Failed;
+		});
+	}
+}
+
+void VirtualTexture::request(int level, int x, int y, std::vector<uint64_t>& missing) {
+	// the page and every missing ancestor up to the first resident one, which is marked as used
+	for (; level < levels; level++, x /= 2, y /= 2) {
+		if (x >= pagesX[level] || y >= pagesY[level]) continue;	// past the edge of a rounded-down level
+		uint64_t page = pageKey(level, x, y);
+		std::unordered_map<uint64_t, int>::iterator found = pageSlots.find(page);
+		if (found != pageSlots.end()) {
+			slots[found->second].lastSeen = frame;
+			return;
+		}
+		missing.push_back(page);
+	}
+}
+
+int VirtualTexture::allocateSlot() {
+	// a free slot, otherwise the least recently seen page that the last feedback did not need;
+	// loads finish frames after the feedback that asked for them, so "not needed" is judged
+	// against that feedback and not against the current frame
+	int best = -1;
+	for (size_t i = 0; i < slots.size(); i++) {
+		const Slot& slot = slots[i];
+		if (!slot.used) return (int)i;
+		if (!slot.pinned && slot.lastSeen < feedbackFrame && (best < 0 || slot.lastSeen < slots[best].lastSeen))
+			best = (int)i;
+	}
+	if (best >= 0) {
+		pageSlots.erase(slots[best].page);
+		slots[best].used = false;
+		patchIndirection(slots[best].page, -1);
+	}
+	return best;
+}
+
+void VirtualTexture::uploadPage(uint64_t page, int slot, int staging) {
+	// the source is the unmapped staging buffer, the copy into the cache runs on the GPU
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffers[staging]);
+	glBindTexture(GL_TEXTURE_2D, physical);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % cacheSlots) * SLOT_SIZE, (slot / cacheSlots) * SLOT_SIZE,
+		SLOT_SIZE, SLOT_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	slots[slot].page = page;
+	slots[slot].used = true;
+	slots[slot].lastSeen = frame;
+	pageSlots[page] = slot;
+	patchIndirection(page, slot);
+}
+
+void VirtualTexture::patchIndirection(uint64_t page, int slot) {
+	int level = (int)(page >> 56);
+	int pageY = (int)((page >> 28) & 0xFFFFFFF);
+	int pageX = (int)(page & 0xFFFFFFF);
+
+	// a resident page points at its slot, an evicted one hands its texels to whatever its parent
+	// falls back to (the root is pinned, so an evicted page always has a parent level)
+	uint8_t entry[4] = { (uint8_t)(slot % cacheSlots), (uint8_t)(slot / cacheSlots), (uint8_t)level, 1 };
+	if (slot < 0) {
+		int parentWidth = std::max(1, tableWidth >> (level + 1));
+		memcpy(entry, &indirectionLevels[level + 1][((size_t)(pageY / 2) * parentWidth + pageX / 2) * 4], 4);
+	}
+
+	// the page covers a 2^(level - l) square in every finer level l; texels that already point at
+	// a finer resident page keep it, only the ones on a coarser page (or on this one) change
+	glBindTexture(GL_TEXTURE_2D, indirection);
+	for (int l = level; l >= 0; l--) {
+		int w = std::max(1, tableWidth >> l), h = std::max(1, tableHeight >> l);
+		int shift = level - l;
+		int x0 = pageX << shift, y0 = pageY << shift;
+		int x1 = std::min((pageX + 1) << shift, w), y1 = std::min((pageY + 1) << shift, h);
+		std::vector<uint8_t>& table = indirectionLevels[l];
+
+		bool changed = false;
+		for (int y = y0; y < y1; y++) {
+			for (int x = x0; x < x1; x++) {
+				uint8_t* texel = &table[((size_t)y * w + x) * 4];
+				if (slot >= 0 ? texel[2] > level : texel[2] == level) {
+					memcpy(texel, entry, 4);
+					changed = true;
+				}
+			}
+		}
+		if (!changed) continue;
+
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+		glTexSubImage2D(GL_TEXTURE_2D, l, x0, y0, x1 - x0, y1 - y0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, &table[((size_t)y0 * w + x0) * 4]);
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VirtualTexture::update() {
+	if (!physical) return;
+	frame++;
+	readFeedback();
+
+	unsigned uploads = 0;
+	for (size_t i = 0; i < loads.size();) {
+		PageLoad& load = *loads[i];
+		bool finished = false;
+
+		if (load.state == Failed) {
+			std::cout << "Failed to read page from " << path << std::endl;
+			unmapStaging(load.staging);
+			finished = true;
+		}
+		else if (load.state == Loaded && uploads < maxUploadsPerFrame) {
+			// no slot means every page is still visible, the request comes back with the next feedback
+			unmapStaging(load.staging);
+			int slot = allocateSlot();
+			if (slot >= 0) {
+				uploadPage(load.page, slot, load.staging);
+				uploads++;
+			}
+			finished = true;
+		}
+
+		if (finished) loads.erase(loads.begin() + i);
+		else i++;
+	}
+}
+
+void VirtualTexture::setUniforms(GLuint program, float lodBias) {
+	glUseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "uVtSize"), (float)width, (float)height);
+	glUniform2f(glGetUniformLocation(program, "uVtPhysicalSize"), (float)(cacheSlots * SLOT_SIZE), (float)(cacheSlots * SLOT_SIZE));
+	glUniform1f(glGetUniformLocation(program, "uVtPageSize"), (float)PAGE_SIZE);
+	glUniform1f(glGetUniformLocation(program, "uVtBorder"), (float)PAGE_BORDER);
+	glUniform1f(glGetUniformLocation(program, "uVtMaxLevel"), (float)(levels - 1));
+	glUniform1f(glGetUniformLocation(program, "uVtLodBias"), lodBias);
+}
+
+void VirtualTexture::bind(GLuint program, GLint physicalUnit, GLint indirectionUnit) {
+	setUniforms(program, 0.0f);
+	glUniform1i(glGetUniformLocation(program, "uVtPhysical"), physicalUnit);
+	glUniform1i(glGetUniformLocation(program, "uVtIndirection"), indirectionUnit);
+
+	glActiveTexture(GL_TEXTURE0 + physicalUnit);
+	glBindTexture(GL_TEXTURE_2D, physical);
+	glActiveTexture(GL_TEXTURE0 + indirectionUnit);
+	glBindTexture(GL_TEXTURE_2D, indirection);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void VirtualTexture::bindFeedback(GLuint program) {
+	// the feedback target is feedbackDivisor times smaller, so its derivatives are that much larger
+	setUniforms(program, -std::log2((float)feedbackDivisor));
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ThreadPool.h"
+/*
+	Virtual texturing for images larger than GL_MAX_TEXTURE_SIZE,
+		HOW TO USE IT:
+	* tile the image once with buildVirtualTexture(image, "name.vtex"): a mip pyramid cut into
+	  128x128 pages (+ 1 texel border for bilinear filtering), stored level by level in one file;
+	  an image too large to decode at once is given as a mosaic, buildVirtualTexture(tiles,
+	  columns, "name.vtex") with equally sized tiles in row-major order, the first row holding
+	  image row 0 (the bottom one when stbi flips on load); only one row of tiles
+	  (then one row of pages per level) is held in memory while the file is written
+	* open("name.vtex") creates the physical page cache (slotsPerAxis^2 pages, RGBA8) and
+	  the indirection texture (RGBA8UI, one texel per page, one mip per pyramid level); the cache
+	  is fixed, the indirection is the only part that follows the image size: 4 bytes per page,
+	  about 1.4 MB for a 64k x 64k mosaic whose texels alone would take 16 GB
+	* put VirtualTexture::glslSource right after #version in the fragment shaders, then use
+	  sampleVirtual(uv) for drawing and virtualFeedback(uv) (uvec4 output) for the feedback pass
+	* every frame: beginFeedback(), draw the virtual textured geometry with the feedback shader,
+	  endFeedback(), update(), then draw normally after bind(program)
+	* the feedback pass renders at 1/divisor of the viewport and is read back asynchronously
+	  (PBO + fence), missing pages are read from disk on the workers straight into mapped unpack
+	  buffers and copied into the cache a few per frame, the least recently seen pages are
+	  replaced; a page arriving or leaving rewrites only the indirection texels it covers
+	* until a page arrives the shader falls back to the nearest resident coarser page, the
+	  coarsest level (a single page) is always resident
+*/
+bool buildVirtualTexture(const std::string& imagePath, const std::string& pagePath, ThreadPool& pool);
+bool buildVirtualTexture(const std::vector<std::string>& tilePaths, int columns, const std::string& pagePath, ThreadPool& pool);
+
+class VirtualTexture
+{
+public:
+	static const int PAGE_SIZE = 128;
+	static const int PAGE_BORDER = 1;
+	static const char* glslSource;
+
+	explicit VirtualTexture(unsigned threadCount = 0);
+	~VirtualTexture();
+
+	bool open(const std::string& pagePath, int slotsPerAxis = 16, int divisor = 8);
+	void close();
+
+	// feedback pass into a small integer framebuffer, restores the framebuffer and viewport
+	void beginFeedback();
+	void endFeedback();
+	void update();
+	void bind(GLuint program, GLint physicalUnit = 1, GLint indirectionUnit = 2);
+	void bindFeedback(GLuint program);
+
+	bool isOpen() const { return physical != 0; }
+	int residentPages() const { return (int)pageSlots.size(); }
+	int pendingPages() const { return (int)loads.size(); }
+
+	unsigned maxUploadsPerFrame = 8;
+	unsigned maxPendingLoads = 16;
+
+private:
+	enum LoadState { Loading, Loaded, Failed };
+
+	struct Slot
+	{
+		uint64_t page = 0;
+		bool used = false;
+		bool pinned = false;
+		unsigned lastSeen = 0;
+	};
+
+	struct PageLoad
+	{
+		uint64_t page = 0;
+		int staging = -1;				// unpack buffer mapped for the worker until the upload
+		unsigned char* pixels = nullptr;
+		std::atomic<int> state{ Loading };
+	};
+
+	ThreadPool pool;
+	std::string path;
+	int width = 0, height = 0, levels = 0;
+	std::vector<int> pagesX, pagesY;
+	std::vector<uint64_t> levelFirstPage;
+	size_t dataOffset = 0;
+
+	int cacheSlots = 0;
+	GLuint physical = 0, indirection = 0;
+	std::vector<Slot> slots;
+	std::unordered_map<uint64_t, int> pageSlots;
+	int tableWidth = 0, tableHeight = 0;
+	std::vector<std::vector<uint8_t>> indirectionLevels;	// RGBA8UI: slot x, slot y, resident level
+
+	std::vector<GLuint> stagingBuffers;
+	std::vector<int> freeStaging;
+
+	std::vector<std::unique_ptr<PageLoad>> loads;
+	unsigned frame = 0;
+	unsigned feedbackFrame = 0;		// frame of the last feedback read back, its pages have lastSeen == feedbackFrame
+
+	int feedbackDivisor = 8;
+	int feedbackWidth = 0, feedbackHeight = 0;
+	GLuint feedbackFbo = 0, feedbackColor = 0, feedbackPbo = 0;
+	GLsync feedbackFence = 0;
+	GLint savedFramebuffer = 0, savedViewport[4] = { 0, 0, 0, 0 };
+
+	static uint64_t pageKey(int level, int x, int y);
+	void setUniforms(GLuint program, float lodBias);
+	size_t pageBytes() const;
+	bool readPage(uint64_t page, unsigned char* pixels) const;
+	unsigned char* mapStaging(int& staging);
+	void unmapStaging(int staging);
+	void resizeFeedback(int viewportWidth, int viewportHeight);
+	void readFeedback();
+	void request(int level, int x, int y, std::vector<uint64_t>& missing);
+	int allocateSlot();
+	void uploadPage(uint64_t page, int slot, int staging);
+	void patchIndirection(uint64_t page, int slot);
+};
@@ -0,0 +1,24 @@
+#pragma once
+/*
+	Small deterministic random numbers (xorshift32),
+		HOW TO USE IT:
+	* Xorshift random(seed): the same seed gives the same sequence on every platform, seed 0 is
+	  replaced by 1 (the generator would stay at 0)
+	* next() returns a float in [0, 1) from the top 24 bits of the state
+	* no shared state: one generator per thread or per use, cheap enough to create in a loop
+*/
+class Xorshift
+{
+public:
+	explicit Xorshift(unsigned seed) : state(seed ? seed : 1) {}
+
+	float next() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+
+private:
+	unsigned state;
+};
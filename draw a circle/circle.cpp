@@ -3,8 +3,13 @@
 
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <cstring>
 #include <math.h>
 
+#include "../common/FrameScheduler.h"
+#include "../common/Shapes2D.h"
+
 using namespace std;
 
 const GLchar* vertexShaderSource =
@@ -27,28 +32,82 @@ int N;
 std::vector<float> vertices;
 std::vector<unsigned> indices;
 
-void createCircle(float r, float N) {
-	float phi = 360.f / N;
-	int triangleCount = N - 2;
-
-	for (int i = 0; i < N; i++) {
-		float currentPhi = phi * i;
-		float x = r * cos(currentPhi * (3.14f / 180.f));
-		float y = r * sin(currentPhi * (3.14f / 180.f));
-		float z = 0.0f;
-		vertices.push_back(x);
-		vertices.push_back(y);
-		vertices.push_back(z);
-	}
-	for (int i = 0; i < triangleCount; i++) {
-		indices.push_back(0);
-		indices.push_back(i + 1);
-		indices.push_back(i + 2);
-	}
+void createCircle(float r, int N) {
+	ShapeSize size = circleSize(N, ShapeTopology::Restart);
+	vertices.resize(size.vertices * 3);
+	indices.resize(size.indices);
+
+	ShapeOutput out;
+	out.vertices = vertices.data();
+	out.stride = 3;
+	out.positionComponents = 3;
+	out.indices = indices.data();
+	out.topology = ShapeTopology::Restart;
+	writeCircle(out, 0.0f, 0.0f, r, N);
 }
 
+// tryb --bench: generowanie ksztaltow po 1M segmentow do gotowych buforow, czas na segment
+int benchmarkShapes() {
+	const int SEGMENTS = 1000000;
+	const int RUNS = 10;
+	std::vector<float> buffer(ringSize(SEGMENTS).vertices * 5);
+	std::vector<unsigned> indexBuffer(ringSize(SEGMENTS).indices);
+
+	ShapeOutput out;
+	out.vertices = buffer.data();
+	out.stride = 5;
+	out.positionComponents = 3;
+	out.uvOffset = 3;
+	out.indices = indexBuffer.data();
+
+	auto measure = [&](const char* name, auto generate) {
+		generate();		// pierwsze przejscie rozgrzewa bufory
+		auto start = std::chrono::steady_clock::now();
+		for (int run = 0; run < RUNS; run++)
+			generate();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		cout << name << ": " << elapsed.count() / RUNS / SEGMENTS << " ns/segment" << endl;
+	};
+
+	// dawna wersja: cos/sin dla kazdego wierzcholka
+	measure("scalar cos/sin circle", [&] {
+		float* v = buffer.data();
+		for (int i = 0; i < SEGMENTS; i++) {
+			float angle = i * 6.2831853f / SEGMENTS;
+			v[i * 5 + 0] = cos(angle);
+			v[i * 5 + 1] = sin(angle);
+			v[i * 5 + 2] = 0.0f;
+			v[i * 5 + 3] = (cos(angle) + 1.0f) / 2.0f;
+			v[i * 5 + 4] = (sin(angle) + 1.0f) / 2.0f;
+		}
+		for (int i = 0; i < SEGMENTS - 2; i++) {
+			indexBuffer[3 * i] = 0;
+			indexBuffer[3 * i + 1] = i + 1;
+			indexBuffer[3 * i + 2] = i + 2;
+		}
+	});
+	measure("circle", [&] { writeCircle(out, 0.0f, 0.0f, 1.0f, SEGMENTS); });
+	measure("ellipse", [&] { writeEllipse(out, 0.0f, 0.0f, 1.0f, 0.5f, SEGMENTS); });
+	measure("arc", [&] { writeArc(out, 0.0f, 0.0f, 1.0f, 0.0f, 3.0f, SEGMENTS); });
+	measure("ring", [&] { writeRing(out, 0.0f, 0.0f, 0.5f, 1.0f, SEGMENTS); });
+	measure("rounded rect", [&] { writeRoundedRect(out, 0.0f, 0.0f, 1.0f, 0.5f, 0.2f, SEGMENTS / 4); });
+
+	// rozmiar bufora indeksow dla wielu kol w jednym wywolaniu: trojkaty vs wachlarze z restartem
+	const size_t CIRCLES = 10000;
+	const int CIRCLE_SEGMENTS = 100;
+	size_t triangleBytes = CIRCLES * circleSize(CIRCLE_SEGMENTS).indices * sizeof(unsigned);
+	size_t restartBytes = CIRCLES * circleSize(CIRCLE_SEGMENTS, ShapeTopology::Restart).indices * sizeof(unsigned);
+	cout << CIRCLES << " circles x " << CIRCLE_SEGMENTS << " segments: GL_TRIANGLES " << triangleBytes / 1024
+		<< " KB, GL_TRIANGLE_FAN + restart " << restartBytes / 1024 << " KB ("
+		<< (double)triangleBytes / restartBytes << "x smaller)" << endl;
+	return 0;
+}
+
+
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench") == 0)
+		return benchmarkShapes();
 
-int main() {
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -122,17 +181,23 @@ int main() {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indices.size(), &indices[0], GL_STATIC_DRAW);
 
+	// kolo to jeden wachlarz zakonczony indeksem restartu
+	glEnable(GL_PRIMITIVE_RESTART);
+	glPrimitiveRestartIndex(SHAPE_RESTART_INDEX);
+
+	// kolo sie nie zmienia: klatka tylko na poczatku i po odslonieciu lub zmianie rozmiaru okna
+	FrameScheduler frames(window);
+
 	//petla zdarzen
-	while (!glfwWindowShouldClose(window)) {
+	while (frames.waitForFrame()) {
 		glClearColor(0.7f, 0.0f, 1.f, 1.f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		glUseProgram(shaderProgram);
 		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLE_FAN, indices.size(), GL_UNSIGNED_INT, 0);
 
 		glfwSwapBuffers(window);
-		glfwPollEvents();
 	}
 
 	glDeleteBuffers(1, &VBO);
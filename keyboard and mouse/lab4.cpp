@@ -8,6 +8,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "../common/CircleMeshCache.h"
 
 const unsigned int window_width = 1000;
 const unsigned int window_height = 800;
@@ -17,31 +18,8 @@ int N = 10;
 unsigned VAO, VBO, EBO;
 unsigned shaderProgram;
 
-std::vector<float> vertices;
-std::vector<unsigned> indices;
-
-void createCircle(float r, float N) {
-    float phi = 360.f / N;
-    int triangleCount = N - 2;
-
-    vertices.clear();
-    indices.clear();
-
-    for (int i = 0; i < N; i++) {
-        float currentPhi = phi * i;
-        float x = r * cos(currentPhi * (3.14f / 180.f));
-        float y = r * sin(currentPhi * (3.14f / 180.f));
-        float z = 0.0f;
-        vertices.push_back(x);
-        vertices.push_back(y);
-        vertices.push_back(z);
-    }
-    for (int i = 0; i < triangleCount; i++) {
-        indices.push_back(0);
-        indices.push_back(i + 1);
-        indices.push_back(i + 2);
-    }
-}
+// wszystkie kola od 8 do 256 wierzcholkow w jednym VBO/EBO, scroll zmienia tylko zakres rysowania
+CircleMeshCache circleMeshes(r, 8, 256, false);
 
 // scroll callback - powiekszanie kola scrollem
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
@@ -49,20 +27,9 @@ void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
         N++;
     }
     else {
-        if (N > 8) {
-            N--;
-        }
+        N--;
     }
-
-    createCircle(r, N);
-
-    // aktualizacja buforow wierzcholkow
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
- 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indices.size(), &indices[0], GL_STATIC_DRAW);
-
+    N = circleMeshes.clamp(N);
 }
 
 // polling - zmiana koloru kola (1, 2, 3)
@@ -130,7 +97,6 @@ int main() {
 
     // cirle setup
     std::cout << "r = " << r;
-    createCircle(r, N);
 
     /* SHADERS */
     unsigned vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -160,14 +126,10 @@ int main() {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+    circleMeshes.upload(VBO, EBO);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indices.size(), &indices[0], GL_STATIC_DRAW);
-
 
     // uColor setup
     GLint uColorLocation = glGetUniformLocation(shaderProgram, "uColor");
@@ -188,7 +150,7 @@ int main() {
         // Renderowanie koa
         glUseProgram(shaderProgram);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        circleMeshes.draw(N);
 
         processInputKeyboard(window, shaderProgram);
         glfwSwapBuffers(window);
@@ -4,18 +4,36 @@
 #include <iostream>
 #include <vector>
 #include <math.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 
+#include "../common/Batch2D.h"
+#include "../common/FrameScheduler.h"
+#include "../common/Xorshift.h"
 
 
+
+// [B] - the same scene through Batch2D (one program, one draw) instead of three programs and three draws
+bool useBatch = false;
+
 // keyboard callback
 void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
+	// every key can change the picture (polled below), the next frame is drawn
+	FrameScheduler::of(window)->invalidate();
+
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
 		glfwSetWindowShouldClose(window, true);
 	}
+	if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		useBatch = !useBatch;
+		std::cout << (useBatch ? "Batch2D" : "separate draws") << std::endl;
+	}
 }
 
 GLfloat currentTranslation[] = { 0.0f, 0.0f, 0.0f };
+GLfloat currentColor[] = { 1.0f, 1.0f, 0.0f };
 
 // polling
 void processInputKeyboard(GLFWwindow* window, unsigned shaderProgram)
@@ -43,6 +61,7 @@ void processInputKeyboard(GLFWwindow* window, unsigned shaderProgram)
 	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && (currentTime - lastKeyPressTime) > debounceDelay) {
 
 		glUniform3f(uColorLocation, colors[colorIndex], colors[colorIndex + 1], colors[colorIndex + 2]);
+		for (int i = 0; i < 3; i++) currentColor[i] = colors[colorIndex + i];
 		colorIndex += 3;
 		if (colorIndex > colors.size() - 3) colorIndex = 0;
 
@@ -67,10 +86,64 @@ void processInputKeyboard(GLFWwindow* window, unsigned shaderProgram)
 		glUniform3f(uPosLocation, currentTranslation[0], currentTranslation[1], currentTranslation[2]);
 		lastKeyPressTime = currentTime;
 	}
+
+	// a held key acts again once the debounce delay is over, no frames in between
+	const int polledKeys[] = { GLFW_KEY_SPACE, GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_UP, GLFW_KEY_DOWN };
+	for (int key : polledKeys)
+		if (glfwGetKey(window, key) == GLFW_PRESS)
+			FrameScheduler::of(window)->wakeAt(lastKeyPressTime + debounceDelay);
+}
+
+
+// NDC of the lab's rectangles -> window pixels for Batch2D
+float pixelX(float x, float width) { return (x + 1.0f) * 0.5f * width; }
+float pixelY(float y, float height) { return (1.0f - y) * 0.5f * height; }
+
+// the three rectangles of the lab as Batch2D shapes: filled, moved with the arrows, outline
+void drawSceneBatched(Batch2D& batch, float width, float height) {
+	batch.setBlend(BlendMode::Opaque);
+	batch.drawRect(pixelX(-0.8f, width), pixelY(0.6f, height), 1.6f * 0.5f * width, 1.2f * 0.5f * height,
+		packColor(0.0f, 1.0f, 0.0f));
+	batch.drawRect(pixelX(-0.9f + currentTranslation[0], width), pixelY(-0.2f + currentTranslation[1], height),
+		0.6f * 0.5f * width, 0.5f * 0.5f * height, packColor(currentColor[0], currentColor[1], currentColor[2], 0.8f));
+
+	const float corners[] = { -0.9f, 0.7f, -0.9f, -0.7f, 0.9f, -0.7f, 0.9f, 0.7f };
+	const unsigned cornerColors[] = {
+		packColor(1.0f, 1.0f, 0.0f), packColor(1.0f, 0.0f, 0.0f),
+		packColor(0.0f, 1.0f, 1.0f), packColor(1.0f, 0.0f, 1.0f),
+	};
+	for (int i = 0; i < 4; i++) {
+		int j = (i + 1) % 4;
+		batch.drawLine(pixelX(corners[2 * i], width), pixelY(corners[2 * i + 1], height),
+			pixelX(corners[2 * j], width), pixelY(corners[2 * j + 1], height), 1.0f, cornerColors[i], cornerColors[j]);
+	}
+}
+
+// --stress N: N moving shapes per frame on top of the scene (rects, lines, circles, quads with two
+// textures, alpha blended), the shape and draw call counts and the CPU time of the batch every second
+void drawStress(Batch2D& batch, int count, const GLuint* textures, float width, float height, float time) {
+	batch.setLayer(1);
+	batch.setBlend(BlendMode::Alpha);
+	Xorshift random(12345);
+	for (int i = 0; i < count; i++) {
+		float x = random.next() * width, y = random.next() * height, size = 2.0f + random.next() * 10.0f;
+		x += 20.0f * sinf(time + i);
+		unsigned color = packColor(random.next(), random.next(), random.next(), 0.7f);
+		switch (i & 3) {
+		case 0: batch.drawRect(x, y, size, size, color); break;
+		case 1: batch.drawLine(x, y, x + size * 2.0f, y + size, 1.0f, color); break;
+		case 2: batch.drawCircle(x, y, size * 0.5f, color); break;
+		default: batch.drawQuad(textures[(i >> 2) & 1], x, y, size, size, color); break;
+		}
+	}
 }
 
+int main(int argc, char** argv) {
+	int stressCount = 0;
+	for (int i = 1; i + 1 < argc; i++)
+		if (strcmp(argv[i], "--stress") == 0) stressCount = atoi(argv[++i]);
+	if (stressCount > 0) useBatch = true;
 
-int main() {
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -293,7 +366,33 @@ int main() {
 
 	char x = '0';
 	bool show_deafult = 1;
-	std::cout << "[1] - task 1\n[2] - task 2\n[Q] - return to default\n";
+	std::cout << "[1] - task 1\n[2] - task 2\n[Q] - return to default\n[B] - Batch2D\n";
+
+	Batch2D batch;
+	batch.create();
+	// pixels, origin in the top left corner, column-major
+	const float projection[16] = {
+		2.0f / window_width, 0.0f, 0.0f, 0.0f,
+		0.0f, -2.0f / window_height, 0.0f, 0.0f,
+		0.0f, 0.0f, -1.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f, 1.0f,
+	};
+	// two 2x2 checker textures for the quads of the stress mode
+	GLuint checkers[2];
+	glGenTextures(2, checkers);
+	for (int t = 0; t < 2; t++) {
+		const unsigned texels[] = { 0xFFFFFFFFu, t ? 0xFF0000FFu : 0xFFFF0000u, t ? 0xFF0000FFu : 0xFFFF0000u, 0xFFFFFFFFu };
+		glBindTexture(GL_TEXTURE_2D, checkers[t]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	double lastReport = 0.0;
+
+	// static scene: frames only after input, window exposure or the key debounce deadline;
+	// the stress mode animates and draws every frame
+	FrameScheduler frames(window);
+	frames.setContinuous(stressCount > 0);
 
 	// uColor setup
 	GLint uColorLocation = glGetUniformLocation(shaderProgram2, "uColor");
@@ -308,7 +407,7 @@ int main() {
 
 
 	// petla zdarzen
-	while (!glfwWindowShouldClose(window)) {
+	while (frames.waitForFrame()) {
 		// window rendering
 		glClearColor(0.2f, 0.1f, 0.141f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
@@ -316,17 +415,33 @@ int main() {
 		// polling
 		processInputKeyboard(window, shaderProgram2);
 
-		glUseProgram(shaderProgram);
-		glBindVertexArray(VAOs[0]);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		glUseProgram(shaderProgram2);
-		glBindVertexArray(VAOs[1]);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-		glUseProgram(shaderProgram3);
-		glBindVertexArray(VAOs[2]);
-		glDrawElements(GL_LINES, 8, GL_UNSIGNED_INT, 0);
+		if (useBatch) {
+			auto start = std::chrono::steady_clock::now();
+			batch.begin(projection);
+			drawSceneBatched(batch, (float)window_width, (float)window_height);
+			drawStress(batch, stressCount, checkers, (float)window_width, (float)window_height, (float)glfwGetTime());
+			batch.end();
+			glDisable(GL_BLEND);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			if (glfwGetTime() - lastReport > 1.0) {
+				lastReport = glfwGetTime();
+				std::cout << batch.shapeCount() << " shapes, " << batch.drawCalls() << " draw calls, " << ms << " ms CPU" << std::endl;
+			}
+		}
+		else {
+			glUseProgram(shaderProgram);
+			glBindVertexArray(VAOs[0]);
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+			glUseProgram(shaderProgram2);
+			glBindVertexArray(VAOs[1]);
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+
+			glUseProgram(shaderProgram3);
+			glBindVertexArray(VAOs[2]);
+			glDrawElements(GL_LINES, 8, GL_UNSIGNED_INT, 0);
+		}
 
 		//if (show_deafult) {
 		//	//rectangle rendering
@@ -374,7 +489,6 @@ int main() {
 		//	break;
 		//}
 		glfwSwapBuffers(window);
-		glfwPollEvents();
 	}
 
 	glDeleteVertexArrays(3, VAOs);
@@ -383,6 +497,8 @@ int main() {
 	glDeleteProgram(shaderProgram);
 	glDeleteProgram(shaderProgram2);
 	glDeleteProgram(shaderProgram3);
+	glDeleteTextures(2, checkers);
+	batch.destroy();
 
 	glfwTerminate();
 
@@ -1,8 +1,7 @@
 #version 330 core
+in vec3 ballColor;
 out vec4 FragColor;
 
-uniform vec3 color;
-
 void main() {
-    FragColor = vec4(color, 1.0);
+    FragColor = vec4(ballColor, 1.0);
 }
@@ -1,6 +1,5 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/random.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glad/glad.h>
 #include <glfw3.h>
@@ -10,6 +9,78 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+#include <new>
+#include <random>
+
+#include "../common/BallCollisions.h"
+#include "../common/DirtyRegion.h"
+#include "../common/FixedTimestep.h"
+#include "../common/ParticleSystem.h"
+#include "../common/Shapes2D.h"
+#include "../common/ThreadPool.h"
+
+// liczniki alokacji dla trybu --headless: licza tylko, gdy petla krokow wlaczy countAllocations,
+// poza nia (i w trybie z oknem) kazda alokacja kosztuje jeden odczyt flagi; atomowe, bo alokuja tez watki puli
+std::atomic<bool> countAllocations(false);
+std::atomic<size_t> allocationCount(0);
+std::atomic<size_t> allocatedBytes(0);
+
+static void countAllocation(size_t size) {
+    if (!countAllocations.load(std::memory_order_relaxed)) return;
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    countAllocation(size);
+    if (void* memory = std::malloc(size ? size : 1)) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+#ifdef __cpp_aligned_new
+// typy z alignas wiekszym niz domyslne (od C++17) ida tymi wersjami, bez nich nie bylyby liczone
+void* operator new(size_t size, std::align_val_t alignment) {
+    countAllocation(size);
+#ifdef _MSC_VER
+    void* memory = _aligned_malloc(size ? size : 1, (size_t)alignment);
+#else
+    void* memory = nullptr;
+    if (posix_memalign(&memory, std::max((size_t)alignment, sizeof(void*)), size ? size : 1) != 0) memory = nullptr;
+#endif
+    if (memory) return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#ifdef _MSC_VER
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept {
+    operator delete(memory, alignment);
+}
+#endif
 
 // shaders
 const GLchar* vertexShaderSource =
@@ -43,16 +114,61 @@ const float BALL_SPEED = 10;
 const float RADIUS = 25.0f;
 
 // Zmienne globalne
-glm::vec2 circlePos(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
-glm::vec2 circleVelocity(0.0f, 0.0f);
+ParticleSystem balls(WINDOW_WIDTH, WINDOW_HEIGHT);
+ThreadPool pool;
+// siatka o komorce ~ srednicy malych kul (--balls), duza kula 0 jest sprawdzana osobno
+BallCollisions collisions(12.0f);
+// fizyka ze stalym krokiem (--hz, domyslnie 120 Hz) na osobnym watku, rysowanie interpoluje
+FixedTimestep timestep(1.0 / 120.0);
+ThreadPool* simulationPool = &pool;
 bool isMoving = false;
+bool launchRequested = false;
+// jedno ziarno dla wszystkich losowan, te same argumenty daja ten sam przebieg
+const unsigned RANDOM_SEED = 1;
+std::mt19937 rng(RANDOM_SEED);
+glm::vec2 launchVelocity(0.0f, 0.0f);
 
 GLuint shaderProgram;
 GLuint VAO, VBO, EBO;
+// pozycja, promien i kolor kazdej kuli (BallInstance), co klatke zapisywane przez ParticleSystem
+GLuint instanceVBO;
 
 std::vector<float> vertices;
 std::vector<unsigned int> indices;
 
+// liczba segmentow z promienia na ekranie: cieciwa najwyzej MAX_CHORD_ERROR px od luku,
+// ponowna tesselacja tylko przy zmianie kubelka (okno zmienia rozmiar)
+const float MAX_CHORD_ERROR = 0.25f;
+int circleSegments = 0;
+int viewportHeight = WINDOW_HEIGHT;
+
+// tryb SDF (klawisz S): jeden kwadrat na kolo, pokrycie liczone w shaderze fragmentow
+bool useSdf = false;
+GLuint sdfProgram;
+GLuint sdfVAO, sdfVBO, sdfEBO;
+std::vector<float> quadVertices;
+std::vector<unsigned int> quadIndices;
+
+// statyczne prostokaty, od ktorych kule sie odbijaja (ciagla detekcja kolizji w ParticleSystem),
+// rysowane shaderami vertexShaderSource / fragmentShaderSource w jednym kolorze
+GLuint obstacleProgram;
+GLuint obstacleVAO, obstacleVBO, obstacleEBO;
+GLsizei obstacleIndexCount = 0;
+
+// tryb zachowany (--retained, klawisz R): scena zostaje w sceneFBO, co klatke rysujemy tylko
+// prostokaty, w ktorych cos sie zmienilo (glScissor), i kopiujemy calosc na ekran; gdy nic sie
+// nie zmienilo, klatka nie jest ani rysowana, ani wyswietlana
+bool retainedMode = false;
+DirtyRegion dirty;
+GLuint sceneFBO = 0, sceneTexture = 0;
+int sceneWidth = 0, sceneHeight = 0;
+int viewportWidth = WINDOW_WIDTH;
+// kule w tej klatce i te, ktore sa teraz w sceneFBO
+std::vector<BallInstance> frameInstances, drawnInstances;
+int presentedFrames = 0, skippedFrames = 0;
+// --stats: co sekunde czasy faz kolizji i licznik klatek trybu zachowanego na stdout
+bool printStats = false;
+
 // Funkcje do kompilacji shaderw
 std::string readShaderSource(const char* filePath) {
     std::string code;
@@ -72,10 +188,7 @@ std::string readShaderSource(const char* filePath) {
     return code;
 }
 
-GLuint compileShader(const char* filePath, GLenum shaderType) {
-    std::string shaderSource = readShaderSource(filePath);
-    const char* shaderCode = shaderSource.c_str();
-
+GLuint compileShaderSource(const char* shaderCode, GLenum shaderType) {
     GLuint shader = glCreateShader(shaderType);
     glShaderSource(shader, 1, &shaderCode, nullptr);
     glCompileShader(shader);
@@ -91,32 +204,177 @@ GLuint compileShader(const char* filePath, GLenum shaderType) {
     return shader;
 }
 
-void createCircle() {
-    int numSegments = 100;
-    vertices.clear();
-    indices.clear();
-
-    vertices.push_back(0.0f);
-    vertices.push_back(0.0f);
-
-    for (int i = 0; i <= numSegments; ++i) {
-        float angle = i * 2.0f * 3.14159f / numSegments;
-        float dx = cos(angle);
-        float dy = sin(angle);
-        vertices.push_back(dx);
-        vertices.push_back(dy);
-
-        if (i > 0) {
-            indices.push_back(0);
-            indices.push_back(i);
-            indices.push_back(i + 1);
+GLuint compileShader(const char* filePath, GLenum shaderType) {
+    std::string shaderSource = readShaderSource(filePath);
+    return compileShaderSource(shaderSource.c_str(), shaderType);
+}
+
+GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(program, 512, nullptr, infoLog);
+        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    return program;
+}
+
+GLuint linkProgram(const char* vertexPath, const char* fragmentPath) {
+    return linkProgram(compileShader(vertexPath, GL_VERTEX_SHADER), compileShader(fragmentPath, GL_FRAGMENT_SHADER));
+}
+
+// kolo jednostkowe (skalowane promieniem instancji), srodek + numSegments wierzcholkow obwodu
+void createCircle(int numSegments) {
+    ShapeSize size = circleSize(numSegments, ShapeTopology::Restart);
+    vertices.resize(size.vertices * 2);
+    indices.resize(size.indices);
+
+    ShapeOutput out;
+    out.vertices = vertices.data();
+    out.indices = indices.data();
+    out.topology = ShapeTopology::Restart;
+    writeCircle(out, 0.0f, 0.0f, 1.0f, numSegments);
+}
+
+// kwadrat kola jednostkowego, margines 1 px na antyaliasing dodaje shader wierzcholkow
+void createCircleQuad() {
+    ShapeSize size = circleQuadSize(ShapeTopology::Restart);
+    quadVertices.resize(size.vertices * 2);
+    quadIndices.resize(size.indices);
+
+    ShapeOutput out;
+    out.vertices = quadVertices.data();
+    out.indices = quadIndices.data();
+    out.topology = ShapeTopology::Restart;
+    writeCircleQuad(out, 0.0f, 0.0f, 1.0f, 0.0f);
+}
+
+// siatka kola w VBO/EBO (VAO musi byc zbindowane)
+void uploadCircle(int segments) {
+    createCircle(segments);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+}
+
+// atrybuty 2 (x, y, promien) i 3 (kolor RGBA8) z instanceVBO, jeden rekord na instancje
+void setupInstanceAttributes() {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(BallInstance), (void*)0);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BallInstance), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+}
+
+// prostokat z rectangles/GK_lab2.cpp (NDC -0.9..-0.3 x -0.7..-0.2, przesuniety o uPos 0.5)
+// przeliczony na piksele swiata width x height
+void addObstacles(float width, float height) {
+    const float left = -0.4f, right = 0.2f, top = -0.2f, bottom = -0.7f;
+    balls.addObstacle((left + 1.0f) * 0.5f * width, (1.0f - top) * 0.5f * height,
+        (right + 1.0f) * 0.5f * width, (1.0f - bottom) * 0.5f * height);
+}
+
+// cztery wierzcholki w pikselach na przeszkode, model = jednostkowa
+void setupObstacles() {
+    std::vector<float> corners;
+    std::vector<unsigned int> triangles;
+    for (const Obstacle& o : balls.obstacleRects()) {
+        unsigned first = (unsigned)corners.size() / 2;
+        float rect[] = { o.left, o.top, o.right, o.top, o.left, o.bottom, o.right, o.bottom };
+        corners.insert(corners.end(), rect, rect + 8);
+        unsigned quad[] = { first, first + 1, first + 2, first + 2, first + 1, first + 3 };
+        triangles.insert(triangles.end(), quad, quad + 6);
+    }
+    obstacleIndexCount = (GLsizei)triangles.size();
+
+    glGenVertexArrays(1, &obstacleVAO);
+    glGenBuffers(1, &obstacleVBO);
+    glGenBuffers(1, &obstacleEBO);
+    glBindVertexArray(obstacleVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, obstacleVBO);
+    glBufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(float), corners.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obstacleEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(unsigned int), triangles.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+}
+
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    glViewport(0, 0, width, height);
+    viewportWidth = width;
+    viewportHeight = height;
+    dirty.markAll();
+}
+
+// kolorowa tekstura wielkosci okna jako zachowany obraz sceny, od nowa przy zmianie rozmiaru
+void ensureSceneFramebuffer() {
+    if (sceneFBO && sceneWidth == viewportWidth && sceneHeight == viewportHeight) return;
+    if (!sceneFBO) {
+        glGenFramebuffers(1, &sceneFBO);
+        glGenTextures(1, &sceneTexture);
+    }
+    sceneWidth = viewportWidth;
+    sceneHeight = viewportHeight;
+    glBindTexture(GL_TEXTURE_2D, sceneTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, sceneWidth, sceneHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    dirty.markAll();
+}
+
+// stare i nowe granice kazdej kuli, ktora od ostatniej narysowanej klatki zmienila polozenie,
+// promien lub kolor (+1 px na antyaliasowana krawedz SDF)
+void markChangedBalls() {
+    if (drawnInstances.size() != frameInstances.size()) {
+        dirty.markAll();
+    }
+    else {
+        for (size_t i = 0; i < frameInstances.size(); i++) {
+            const BallInstance& now = frameInstances[i];
+            const BallInstance& before = drawnInstances[i];
+            if (now.x == before.x && now.y == before.y && now.radius == before.radius && now.color == before.color)
+                continue;
+            float r = before.radius + 1.0f;
+            dirty.add(before.x - r, before.y - r, before.x + r, before.y + r);
+            r = now.radius + 1.0f;
+            dirty.add(now.x - r, now.y - r, now.x + r, now.y + r);
         }
     }
-    indices.back() = 1; // Closing the circle
+    drawnInstances.swap(frameInstances);
+}
+
+// wywolywane co klatke, bufory zmieniaja sie tylko gdy zmieni sie kubelek LOD
+void updateTessellation() {
+    float radiusPixels = RADIUS * viewportHeight / WINDOW_HEIGHT;
+    int segments = circleSegmentsForError(radiusPixels, MAX_CHORD_ERROR, 8, 512);
+    if (segments == circleSegments) return;
+
+    circleSegments = segments;
+    uploadCircle(segments);
+    dirty.markAll();
+    std::cout << "Circle of " << radiusPixels << " px: " << segments << " segments" << std::endl;
 }
 
 void setupBuffers() {
-    createCircle();
+    createCircleQuad();
+
+    glGenBuffers(1, &instanceVBO);
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -124,74 +382,325 @@ void setupBuffers() {
 
     glBindVertexArray(VAO);
 
+    // wierzcholki i indeksy wypelnia updateTessellation
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    updateTessellation();
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    setupInstanceAttributes();
+
+    // jeden wachlarz na kolo (N + 3 indeksy zamiast 3N), kolejne ksztalty po indeksie restartu
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(SHAPE_RESTART_INDEX);
+
+    glGenVertexArrays(1, &sdfVAO);
+    glGenBuffers(1, &sdfVBO);
+    glGenBuffers(1, &sdfEBO);
+
+    glBindVertexArray(sdfVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, sdfVBO);
+    glBufferData(GL_ARRAY_BUFFER, quadVertices.size() * sizeof(float), quadVertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sdfEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, quadIndices.size() * sizeof(unsigned int), quadIndices.data(), GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
+    setupInstanceAttributes();
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
-void updateCircle(float deltaTime, float speed) {
-    if (!isMoving) return;
+// tryb --bench: N kol o promieniu r jednym glDrawElementsInstanced - siatka 100 segmentow, siatka
+// z liczba segmentow z bledu cieciwy i kwadrat SDF; czas GPU (GL_TIME_ELAPSED), wierzcholki, piksele na ms
+void benchmarkCircles() {
+    const int RUNS = 10;
+    const int FIXED_SEGMENTS = 100;
+    const int counts[] = { 1, 100, 10000, 1000000 };
+    const float radii[] = { 2.0f, 8.0f, 32.0f };
+
+    GLuint query;
+    glGenQueries(1, &query);
+    std::vector<BallInstance> instances;
+
+    for (int count : counts) {
+        for (float radius : radii) {
+            instances.resize(count);
+            std::mt19937 positions(RANDOM_SEED);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            for (BallInstance& instance : instances) {
+                instance.x = unit(positions) * WINDOW_WIDTH;
+                instance.y = unit(positions) * WINDOW_HEIGHT;
+                instance.radius = radius;
+                instance.color = 0xFFFFFFFFu;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(BallInstance), instances.data(), GL_STATIC_DRAW);
+
+            for (int path = 0; path < 3; path++) {
+                bool sdf = path == 2;
+                size_t vertexCount;
+                GLsizei indexCount;
+                if (sdf) {
+                    glBindVertexArray(sdfVAO);
+                    vertexCount = quadVertices.size() / 2;
+                    indexCount = (GLsizei)quadIndices.size();
+                }
+                else {
+                    glBindVertexArray(VAO);
+                    uploadCircle(path == 1 ? circleSegmentsForError(radius, MAX_CHORD_ERROR, 8, 512) : FIXED_SEGMENTS);
+                    vertexCount = vertices.size() / 2;
+                    indexCount = (GLsizei)indices.size();
+                }
+
+                const char* name = sdf ? "sdf     " : (path == 1 ? "adaptive" : "mesh    ");
+                GLenum mode = sdf ? GL_TRIANGLE_STRIP : GL_TRIANGLE_FAN;
+                glUseProgram(sdf ? sdfProgram : shaderProgram);
+
+                glDrawElementsInstanced(mode, indexCount, GL_UNSIGNED_INT, 0, count);
+                glFinish();
+                glBeginQuery(GL_TIME_ELAPSED, query);
+                for (int run = 0; run < RUNS; run++)
+                    glDrawElementsInstanced(mode, indexCount, GL_UNSIGNED_INT, 0, count);
+                glEndQuery(GL_TIME_ELAPSED);
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+
+                double ms = nanoseconds / 1e6 / RUNS;
+                double coveredPixels = count * 3.14159265 * radius * radius;
+                std::cout << name << " " << count << " circles r " << radius << ": " << ms << " ms, "
+                    << count * vertexCount << " vertices, " << coveredPixels / 1e6 / (ms > 0.0 ? ms : 1e-6)
+                    << " Mpix/ms" << std::endl;
+            }
+        }
+    }
+
+    glBindVertexArray(0);
+    glDeleteQueries(1, &query);
+}
+
+// kroki symulacji, na watku symulacji (SimulationThread); kolizje i ruch rozdzielone na pule
+void simulate(int steps) {
+    for (int step = 0; step < steps; step++) {
+        collisions.resolve(balls, simulationPool);
+        balls.step((float)timestep.step(), nullptr, simulationPool);
+    }
+}
 
-    circlePos += circleVelocity * deltaTime * speed;
+// kulka 0 to pierwotne kolo, reszta (--balls N) dochodzi przy starcie. Co klatke: czekamy na kroki
+// zlecone w poprzedniej klatce, zapisujemy do zmapowanego instanceVBO (osierocony, GPU moze jeszcze
+// czytac stary) stan interpolowany miedzy dwoma ostatnimi krokami i zlecamy kroki na nastepna klatke,
+// ktore licza sie w tle, gdy ten watek rysuje. Symulacja nie wola GL: odbicia zapisuje jako nowy
+// kolor i bit w balls.events, tu trafiaja do GPU jednym zapisem, niezaleznie od liczby zderzen
+void updateBalls(SimulationThread& simulation, float deltaTime) {
+    simulation.wait();
+
+    // stan kul zmieniamy tylko, gdy watek symulacji stoi
+    if (launchRequested) {
+        balls.vx[0] = launchVelocity.x;
+        balls.vy[0] = launchVelocity.y;
+        launchRequested = false;
+    }
 
-    // Detekcja kolizji z krawdziami okna
-    bool collision = false;
-    // lewa krawedz
-    if (circlePos.x - RADIUS < 0) {
-        circlePos.x = RADIUS;
-        circleVelocity.x *= -1;
-        collision = true;
+    // --stats: co sekunde czasy faz kolizji i zdarzenia z krokow tej klatki, gdy kul jest wiecej niz jedna
+    static double lastReport = 0.0;
+    if (printStats && balls.size() > 1 && glfwGetTime() - lastReport > 1.0) {
+        lastReport = glfwGetTime();
+        const CollisionTimings& timings = collisions.timings();
+        std::cout << balls.size() << " balls: broad phase " << timings.buildMilliseconds << " ms, narrow phase "
+            << timings.narrowMilliseconds << " ms, " << timings.contacts << " contacts, "
+            << balls.countEvents(EVENT_WALL | EVENT_OBSTACLE) << " bounced, "
+            << balls.countEvents(EVENT_BALL) << " touched a ball" << std::endl;
     }
-    // prawa krawedz
-    else if (circlePos.x + RADIUS > WINDOW_WIDTH) {
-        circlePos.x = WINDOW_WIDTH - RADIUS;
-        circleVelocity.x *= -1;
-        collision = true;
+    static double lastRetainedReport = 0.0;
+    if (printStats && retainedMode && glfwGetTime() - lastRetainedReport > 1.0) {
+        lastRetainedReport = glfwGetTime();
+        std::cout << "retained: " << presentedFrames << " frames drawn, " << skippedFrames << " skipped" << std::endl;
+        presentedFrames = skippedFrames = 0;
     }
 
-    // gorna krawedz
-    if (circlePos.y - RADIUS < 0) {
-        circlePos.y = RADIUS;
-        circleVelocity.y *= -1;
-        collision = true;
+    size_t bytes = balls.size() * sizeof(BallInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (retainedMode) {
+        // kopia na CPU do porownania z narysowana, do GPU tylko gdy cos sie zmienilo
+        frameInstances.resize(balls.size());
+        balls.writeInstances(timestep.alpha(), frameInstances.data(), &pool);
+        markChangedBalls();
+        if (!dirty.empty())
+            glBufferData(GL_ARRAY_BUFFER, bytes, drawnInstances.data(), GL_STREAM_DRAW);
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        BallInstance* mapped = (BallInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) {
+            balls.writeInstances(timestep.alpha(), mapped, &pool);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
     }
-    // dolna krawedz
-    else if (circlePos.y + RADIUS > WINDOW_HEIGHT) {
-        circlePos.y = WINDOW_HEIGHT - RADIUS;
-        circleVelocity.y *= -1;
-        collision = true;
+    balls.clearEvents();
+
+    simulation.start(timestep.advance(deltaTime));
+}
+
+// tryb --headless [--balls N] [--steps S] [--hz H] [--threads 1]: sama symulacja bez okna i GL,
+// wynik jako JSON do porownywania miedzy commitami. Swiat rosnie z liczba kul (stala gestosc, nie
+// mniej niz okno); alokacje liczone tylko w petli krokow, checksum wykrywa zmiane zachowania
+int runHeadless(size_t count, int steps, bool singleThread) {
+    float side = std::sqrt(count * 400.0f);
+    float width = std::max((float)WINDOW_WIDTH, side * 4.0f / 3.0f);
+    float height = std::max((float)WINDOW_HEIGHT, side * 3.0f / 4.0f);
+    balls.clear();
+    balls.setBounds(width, height);
+    balls.spawnRandom(count, 2.0f, 6.0f, 200.0f, RANDOM_SEED);
+    addObstacles(width, height);
+    simulationPool = singleThread ? nullptr : &pool;
+
+    // pierwszy krok rozgrzewa bufory siatki, dalej nic nie powinno alokowac
+    simulate(1);
+    allocationCount = 0;
+    allocatedBytes = 0;
+    countAllocations = true;
+    double broadPhase = 0.0, narrowPhase = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < steps; step++) {
+        simulate(1);
+        broadPhase += collisions.timings().buildMilliseconds;
+        narrowPhase += collisions.timings().narrowMilliseconds;
     }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    countAllocations = false;
+    size_t allocations = allocationCount, bytes = allocatedBytes;
+
+    double checksum = 0.0;
+    for (size_t i = 0; i < balls.size(); i++)
+        checksum += balls.x[i] + balls.y[i];
+
+    std::cout << "{\n"
+        << "  \"balls\": " << count << ",\n"
+        << "  \"steps\": " << steps << ",\n"
+        << "  \"step_seconds\": " << timestep.step() << ",\n"
+        << "  \"seed\": " << RANDOM_SEED << ",\n"
+        << "  \"threads\": " << (singleThread ? 1 : pool.size() + 1) << ",\n"
+        << "  \"world\": [" << width << ", " << height << "],\n"
+        << "  \"seconds\": " << seconds << ",\n"
+        << "  \"steps_per_second\": " << steps / seconds << ",\n"
+        << "  \"ns_per_body_step\": " << seconds * 1e9 / ((double)steps * count) << ",\n"
+        << "  \"broad_phase_ms\": " << broadPhase / steps << ",\n"
+        << "  \"narrow_phase_ms\": " << narrowPhase / steps << ",\n"
+        << "  \"allocations\": " << allocations << ",\n"
+        << "  \"allocated_bytes\": " << bytes << ",\n"
+        << "  \"checksum\": " << std::setprecision(17) << checksum << "\n"
+        << "}" << std::endl;
+    return 0;
+}
 
-    if (collision) {
-        // Zmiana koloru na losowy
+// przeszkody i wszystkie kule jednym wywolaniem
+void drawScene() {
+    glUseProgram(obstacleProgram);
+    glBindVertexArray(obstacleVAO);
+    glDrawElements(GL_TRIANGLES, obstacleIndexCount, GL_UNSIGNED_INT, 0);
+
+    GLsizei ballCount = (GLsizei)balls.size();
+    if (useSdf) {
+        glUseProgram(sdfProgram);
+        glBindVertexArray(sdfVAO);
+        glDrawElementsInstanced(GL_TRIANGLE_STRIP, quadIndices.size(), GL_UNSIGNED_INT, 0, ballCount);
+    }
+    else {
         glUseProgram(shaderProgram);
-        glUniform3f(glGetUniformLocation(shaderProgram, "color"),
-            glm::linearRand(0.0f, 1.0f),
-            glm::linearRand(0.0f, 1.0f),
-            glm::linearRand(0.0f, 1.0f));
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLE_FAN, indices.size(), GL_UNSIGNED_INT, 0, ballCount);
     }
 }
 
+// tryb zachowany: kazdy brudny prostokat (wspolrzedne swiata, y w dol) czyscimy i rysujemy w sceneFBO
+// pod glScissor, potem caly obraz idzie na ekran; false = nic do wyswietlenia
+bool drawDirtyRegions() {
+    ensureSceneFramebuffer();
+    if (dirty.empty()) return false;
+
+    float scaleX = (float)sceneWidth / WINDOW_WIDTH, scaleY = (float)sceneHeight / WINDOW_HEIGHT;
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glEnable(GL_SCISSOR_TEST);
+    for (const DirtyRect& rect : dirty.rects()) {
+        int left = (int)std::floor(rect.left * scaleX), right = (int)std::ceil(rect.right * scaleX);
+        int bottom = (int)std::floor((WINDOW_HEIGHT - rect.bottom) * scaleY);
+        int top = (int)std::ceil((WINDOW_HEIGHT - rect.top) * scaleY);
+        glScissor(left, bottom, right - left, top - bottom);
+        glClear(GL_COLOR_BUFFER_BIT);
+        drawScene();
+    }
+    glDisable(GL_SCISSOR_TEST);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, sceneWidth, sceneHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    dirty.clear();
+    return true;
+}
+
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
         if (!isMoving) {
             // Losowanie pocztkowego kierunku ruchu
-            circleVelocity = glm::ballRand(100.0f); // Prdko losowa
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            float angle = 6.2831853f * unit(rng), length = 100.0f * std::sqrt(unit(rng));
+            glm::vec2 velocity = glm::vec2(std::cos(angle), std::sin(angle)) * length * BALL_SPEED; // Prdko losowa
+            launchVelocity = velocity;
+            launchRequested = true;
             isMoving = true;
         }
     }
+    if (key == GLFW_KEY_S && action == GLFW_PRESS) {
+        useSdf = !useSdf;
+        std::cout << (useSdf ? "SDF circle (1 quad)" : "Tessellated circle") << std::endl;
+        dirty.markAll();
+    }
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        retainedMode = !retainedMode;
+        std::cout << (retainedMode ? "Retained mode (dirty rectangles)" : "Full redraw every frame") << std::endl;
+        drawnInstances.clear();
+        dirty.markAll();
+    }
 }
 
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--headless") == 0) {
+        size_t count = 100000;
+        int steps = 100;
+        bool singleThread = false;
+        for (int i = 2; i + 1 < argc; i++) {
+            if (strcmp(argv[i], "--balls") == 0) count = (size_t)atol(argv[++i]);
+            else if (strcmp(argv[i], "--steps") == 0) steps = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--hz") == 0) timestep.setRate(atof(argv[++i]));
+            else if (strcmp(argv[i], "--threads") == 0) singleThread = atoi(argv[++i]) == 1;
+        }
+        return runHeadless(count, steps > 0 ? steps : 1, singleThread);
+    }
+
+    // pierwotne kolo na srodku, stoi do wcisniecia spacji
+    balls.add(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, 0.0f, 0.0f, RADIUS, packColor(1.0f, 1.0f, 1.0f));
+    addObstacles(WINDOW_WIDTH, WINDOW_HEIGHT);
+    // --balls N: dodatkowe losowe kule, --hz N: czestotliwosc kroku symulacji
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--balls") == 0)
+            balls.spawnRandom((size_t)atol(argv[++i]), 2.0f, 6.0f, 200.0f, RANDOM_SEED);
+        else if (strcmp(argv[i], "--hz") == 0)
+            timestep.setRate(atof(argv[++i]));
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--retained") == 0) retainedMode = true;
+        else if (strcmp(argv[i], "--stats") == 0) printStats = true;
+    }
+    dirty.setBounds(WINDOW_WIDTH, WINDOW_HEIGHT);
+
     // Inicjalizacja GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -221,43 +730,45 @@ int main() {
 
     // Ustawienie callbacku klawiszy
     glfwSetKeyCallback(window, keyCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
     // Ustawienie koloru ta
     glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
 
     // Kompilacja shaderw
-    GLuint vertexShader = compileShader("vertex_shader.glsl", GL_VERTEX_SHADER);
-    GLuint fragmentShader = compileShader("fragment_shader.glsl", GL_FRAGMENT_SHADER);
-
-    // Linkowanie shaderw
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    int success;
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-    }
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    glUseProgram(shaderProgram);
-    glUniform3f(glGetUniformLocation(shaderProgram, "color"), 1.0f, 1.0f, 1.0f);
+    shaderProgram = linkProgram("vertex_shader.glsl", "fragment_shader.glsl");
+    sdfProgram = linkProgram("sdf_vertex_shader.glsl", "sdf_fragment_shader.glsl");
+    obstacleProgram = linkProgram(compileShaderSource(vertexShaderSource, GL_VERTEX_SHADER),
+        compileShaderSource(fragmentShaderSource, GL_FRAGMENT_SHADER));
 
     setupBuffers();
+    setupObstacles();
 
     // Ustawienie macierzy projekcji
     glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(WINDOW_WIDTH), static_cast<float>(WINDOW_HEIGHT), 0.0f, -1.0f, 1.0f);
     glUseProgram(shaderProgram);
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+    glUseProgram(sdfProgram);
+    glUniformMatrix4fv(glGetUniformLocation(sdfProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+    glm::mat4 identity(1.0f);
+    glUseProgram(obstacleProgram);
+    glUniformMatrix4fv(glGetUniformLocation(obstacleProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(obstacleProgram, "model"), 1, GL_FALSE, &identity[0][0]);
+    glUniform3f(glGetUniformLocation(obstacleProgram, "color"), 1.0f, 1.0f, 0.0f);
+
+    // krawedz kola SDF jest polprzezroczysta
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        benchmarkCircles();
+        glfwTerminate();
+        return 0;
+    }
 
     // Wektor przechowujcy poprzedni czas
     float lastFrame = 0.0f;
+    SimulationThread simulation(simulate);
 
     // MAIN LOOP
     while (!glfwWindowShouldClose(window)) {
@@ -267,21 +778,25 @@ int main() {
         lastFrame = currentFrame;
 
         // Aktualizacja pozycji koa
-        updateCircle(deltaTime, BALL_SPEED);
-
-        // Czyszczenie ekranu
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        // Rysowanie koa
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(circlePos, 0.0f));
-        model = glm::scale(model, glm::vec3(RADIUS, RADIUS, 1.0f));
-
-        glUseProgram(shaderProgram);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, &model[0][0]);
+        updateBalls(simulation, deltaTime);
 
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        updateTessellation();
+
+        if (retainedMode) {
+            if (!drawDirtyRegions()) {
+                // nic sie nie zmienilo: bez rysowania i wymiany buforow, czekamy na zdarzenia do nastepnego kroku
+                skippedFrames++;
+                glfwWaitEventsTimeout(timestep.step());
+                continue;
+            }
+            presentedFrames++;
+        }
+        else {
+            // Czyszczenie ekranu
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawScene();
+        }
 
         // Wymiana buforw
         glfwSwapBuffers(window);
@@ -294,6 +809,15 @@ int main() {
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &sdfVAO);
+    glDeleteBuffers(1, &sdfVBO);
+    glDeleteBuffers(1, &sdfEBO);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteVertexArrays(1, &obstacleVAO);
+    glDeleteBuffers(1, &obstacleVBO);
+    glDeleteBuffers(1, &obstacleEBO);
+    if (sceneFBO) glDeleteFramebuffers(1, &sceneFBO);
+    if (sceneTexture) glDeleteTextures(1, &sceneTexture);
 
     glfwTerminate();
     return 0;
@@ -0,0 +1,12 @@
+#version 330 core
+in vec2 local;
+in vec3 ballColor;
+out vec4 FragColor;
+
+void main() {
+    // signed distance to the rim in radii, fwidth turns it into pixels for a 1 px edge
+    float distance = length(local) - 1.0;
+    float coverage = clamp(0.5 - distance / fwidth(distance), 0.0, 1.0);
+    if (coverage <= 0.0) discard;
+    FragColor = vec4(ballColor, coverage);
+}
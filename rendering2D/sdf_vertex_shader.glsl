@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;         // corner of the unit square
+layout (location = 2) in vec3 aInstance;    // x, y, radius
+layout (location = 3) in vec4 aColor;
+
+uniform mat4 projection;
+
+out vec2 local;
+out vec3 ballColor;
+
+void main() {
+    // 1 px margin around the rim for the anti-aliased edge
+    local = aPos * (1.0 + 1.0 / aInstance.z);
+    ballColor = aColor.rgb;
+    gl_Position = projection * vec4(aInstance.xy + local * aInstance.z, 0.0, 1.0);
+}
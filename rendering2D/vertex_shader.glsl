@@ -1,9 +1,13 @@
 #version 330 core
 layout (location = 0) in vec2 aPos;
+layout (location = 2) in vec3 aInstance;    // x, y, radius
+layout (location = 3) in vec4 aColor;
 
-uniform mat4 model;
 uniform mat4 projection;
 
+out vec3 ballColor;
+
 void main() {
-    gl_Position = projection * model * vec4(aPos, 0.0, 1.0);
+    ballColor = aColor.rgb;
+    gl_Position = projection * vec4(aInstance.xy + aPos * aInstance.z, 0.0, 1.0);
 }
@@ -2,19 +2,38 @@
 #include <glfw3.h>
 
 #include <iostream>
+#include <memory>
 #include <vector>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "../common/TextureBudget.h"
+#include "../common/TextureCompressor.h"
+#include "../common/TextureLoader.h"
+#include "../common/VirtualTexture.h"
+
 // VAO VBO EBO
 unsigned int VBO[2], VAO[2], EBO[2];
-const GLchar* image_path;
-GLint width, height, nrChannels;
-GLuint texture;
 GLuint shaderProgram;
 
+// wszystkie obrazy w jednej tablicy tekstur (ladowanej w tle), klawisze zmieniaja tylko warstwe
+enum ImageLayer { WALL_LAYER = 0, CAT_LAYER = 1, CAR_LAYER = 2 };
+TextureSlot imageArray;
+GLint currentLayer = CAT_LAYER;
+
+// tryb 4: kwadrat z tekstura wirtualna (images.vtex, strony 128x128 doczytywane z dysku);
+// tworzona dopiero w main, zeby --compress i --tile nie uruchamialy jej watkow
+std::unique_ptr<VirtualTexture> virtualTexture;
+GLuint virtualProgram, feedbackProgram;
+bool virtualMode = 0;
+float virtualZoom = 1.0f;
+
 const GLchar* vertexShaderSource =
 "#version 330 core\n"
 "layout (location = 0) in vec3 position;\n"
@@ -33,14 +52,44 @@ const GLchar* fragmentShaderSource =
 "in vec3 vertexColor;\n"
 "in vec2 texCoord;\n"
 "out vec4 fragmentColor;\n"
-"uniform sampler2D uTexture;\n"
+"uniform sampler2DArray uTexture;\n"
+"uniform int uLayer;\n"
+"uniform vec2 uLayerScale;\n"			// czesc warstwy zajeta przez obraz (reszta to wypelnienie)
 "uniform vec3 customColor;\n"
 "void main(){\n"
-"vec4 texColor = texture(uTexture, texCoord);\n"
+"vec4 texColor = texture(uTexture, vec3(texCoord * uLayerScale, uLayer));\n"
 "fragmentColor = vec4(mix(texColor.rgb, customColor, 0.5), texColor.a);\n"
 "}\n\0";
 
+// fragment shadery trybu 4, skladane z: #version + VirtualTexture::glslSource + main
+const GLchar* shaderVersion = "#version 330 core\n";
+
+const GLchar* virtualFragmentSource =
+"in vec2 texCoord;\n"
+"out vec4 fragmentColor;\n"
+"uniform float uZoom;\n"
+"void main(){\n"
+"fragmentColor = sampleVirtual((texCoord - 0.5) / uZoom + 0.5);\n"
+"}\n\0";
+
+const GLchar* feedbackFragmentSource =
+"in vec2 texCoord;\n"
+"out uvec4 feedback;\n"
+"uniform float uZoom;\n"
+"void main(){\n"
+"feedback = virtualFeedback((texCoord - 0.5) / uZoom + 0.5);\n"
+"}\n\0";
+
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+    // w trybie 4 scroll przybliza obraz, wtedy potrzebne sa coraz drobniejsze strony
+    if (virtualMode) {
+        virtualZoom *= std::pow(1.25f, (float)yoffset);
+        if (virtualZoom < 1.0f)
+            virtualZoom = 1.0f;
+        else if (virtualZoom > 4096.0f)
+            virtualZoom = 4096.0f;
+        return;
+    }
     static float colorMix = 0.5f;
     colorMix += yoffset * 0.1f; // Adjust scrolling sensitivity here
     if (colorMix > 1.0f)
@@ -55,32 +104,121 @@ void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 bool draw = 0;
 void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
-        image_path = "wall.jpg";
+        currentLayer = WALL_LAYER;
         glBindVertexArray(VAO[0]);
         draw = 0;
+        virtualMode = 0;
     }
     if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
         glBindVertexArray(VAO[1]);
-        image_path = "cat.jpg";
+        currentLayer = CAT_LAYER;
         draw = 0;
+        virtualMode = 0;
     }
     if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
         draw = 1;
+        virtualMode = 0;
+    }
+    if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS && virtualTexture && virtualTexture->isOpen()) {
+        virtualMode = 1;
     }
+}
 
-        stbi_set_flip_vertically_on_load(true);
-        GLubyte* data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
+GLuint createVirtualProgram(GLuint vertexShader, const GLchar* fragmentMain) {
+    const GLchar* sources[] = { shaderVersion, VirtualTexture::glslSource, fragmentMain };
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 3, sources, NULL);
+    glCompileShader(fragmentShader);
+    int success;
+    char infoLog[512];
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    glDeleteShader(fragmentShader);
+    return program;
 }
 
-int main() {
+// tryb offline: GK_lab_5 --compress [--bc3] [out.ktx2 obraz1 obraz2 ...]
+// bez plikow kompresuje wall/cat/car do images.ktx2, ktory laduje sie zamiast jpg
+int compressImagesMain(int argc, char** argv) {
+    BlockFormat format = BlockFormat::BC1;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--bc3") == 0) format = BlockFormat::BC3;
+        else args.push_back(argv[i]);
+    }
+
+    std::string output = "images.ktx2";
+    std::vector<std::string> sources = { "wall.jpg", "cat.jpg", "car.jpg" };
+    if (args.size() >= 2) {
+        output = args[0];
+        sources.assign(args.begin() + 1, args.end());
+    }
+
+    stbi_set_flip_vertically_on_load(true);
+    ThreadPool pool;
+    auto start = std::chrono::steady_clock::now();
+    if (!compressImages(sources, output, format, true, pool))
+        return -1;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Saved " << output << " in " << elapsed.count() << " s" << std::endl;
+    return 0;
+}
+
+// tryb offline: GK_lab_5 --tile [--columns N] [obraz... out.vtex]
+// tnie obraz na piramide stron 128x128 dla trybu 4, bez argumentow wall.jpg -> images.vtex;
+// kilka obrazow to mozaika N kolumn (kafle tej samej wielkosci, wierszami), dekodowana po jednym wierszu kafli
+int tileImageMain(int argc, char** argv) {
+    int columns = 1;
+    std::vector<std::string> args;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--columns") == 0 && i + 1 < argc) columns = atoi(argv[++i]);
+        else args.push_back(argv[i]);
+    }
+
+    std::string output = "images.vtex";
+    std::vector<std::string> sources = { "wall.jpg" };
+    if (args.size() >= 2) {
+        output = args.back();
+        sources.assign(args.begin(), args.end() - 1);
+    }
+
+    // obrazy sa odwracane przy wczytywaniu, wiec wiersze kafli (podane od gory) ida od dolu
+    if (columns > 0 && sources.size() % columns == 0) {
+        std::vector<std::string> bottomUp;
+        for (size_t row = sources.size() / columns; row-- > 0;)
+            bottomUp.insert(bottomUp.end(), sources.begin() + row * columns, sources.begin() + (row + 1) * columns);
+        sources.swap(bottomUp);
+    }
+
+    stbi_set_flip_vertically_on_load(true);
+    ThreadPool pool;
+    auto start = std::chrono::steady_clock::now();
+    if (!buildVirtualTexture(sources, columns, output, pool))
+        return -1;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Saved " << output << " in " << elapsed.count() << " s" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "--compress") == 0)
+        return compressImagesMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--tile") == 0)
+        return tileImageMain(argc, argv);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -104,26 +242,20 @@ int main() {
     glViewport(0, 0, window_width, window_height);
 
     // TEXTURE SETUP //
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-   // GLint width, height, nrChannels;
+    // dekodowanie i upload przez PBO w tle, sloty domyslnie GL_REPEAT + GL_NEAREST
     stbi_set_flip_vertically_on_load(true);
-    image_path = "cat.jpg";
-    GLubyte* data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    // budzet pamieci tekstur: nieuzywane tekstury sa usuwane i doczytywane przy nastepnym bind;
+    // --budget MB: maly budzet (np. --budget 1) usuwa tablice obrazow w trybie 4, gdzie nie jest
+    // rysowana, a powrot do trybow 1-3 pokazuje miniature do konca ponownego wczytania
+    size_t budgetMegabytes = 64;
+    for (int i = 1; i + 1 < argc; i++)
+        if (strcmp(argv[i], "--budget") == 0) budgetMegabytes = (size_t)atol(argv[++i]);
+    TextureLoader textureLoader;
+    TextureBudget textureBudget(textureLoader, budgetMegabytes * 1024 * 1024);
+    textureBudget.loadArray(imageArray, { "wall.jpg", "cat.jpg", "car.jpg" }, "images.ktx2");
+    virtualTexture = std::make_unique<VirtualTexture>();
+    if (!virtualTexture->open("images.vtex"))
+        std::cout << "images.vtex not found, run with --tile to enable mode 4" << std::endl;
 
     // aktywowanie funkcji
     glfwSetScrollCallback(window, scrollCallback);
@@ -230,40 +362,66 @@ int main() {
         glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    virtualProgram = createVirtualProgram(vertexShader, virtualFragmentSource);
+    feedbackProgram = createVirtualProgram(vertexShader, feedbackFragmentSource);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
     // Set uniforms
    // glUseProgram(shaderProgram);
    // glUniform1i(glGetUniformLocation(shaderProgram, "uTexture"), 0);
+    GLint uLayerLocation = glGetUniformLocation(shaderProgram, "uLayer");
+    GLint uLayerScaleLocation = glGetUniformLocation(shaderProgram, "uLayerScale");
+    // warstwy nie sa rozciagane do najwiekszego obrazu, wspolrzedne skaluje sie do zajetej czesci
+    auto setLayer = [&](GLint layer) {
+        glUniform1i(uLayerLocation, layer);
+        bool known = (size_t)(2 * layer + 1) < imageArray.layerScale.size();
+        glUniform2f(uLayerScaleLocation, known ? imageArray.layerScale[2 * layer] : 1.0f,
+            known ? imageArray.layerScale[2 * layer + 1] : 1.0f);
+    };
 
     while (!glfwWindowShouldClose(window)) {
         // Input
         processInput(window);
+        textureLoader.update();
+        textureBudget.update();
+
+        // feedback pass - ktore strony sa widoczne, odczyt asynchroniczny w kolejnych klatkach
+        if (virtualMode) {
+            virtualTexture->beginFeedback();
+            virtualTexture->bindFeedback(feedbackProgram);
+            glUniform1f(glGetUniformLocation(feedbackProgram, "uZoom"), virtualZoom);
+            glBindVertexArray(VAO[0]);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            virtualTexture->endFeedback();
+            virtualTexture->update();
+        }
 
         // Rendering commands
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        glBindTexture(GL_TEXTURE_2D, texture);
         glUseProgram(shaderProgram);
+        if (!virtualMode)
+            textureBudget.bind(imageArray);
 
-        if (draw) {
-            image_path = "wall.jpg";
-            GLubyte* data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-
+        if (virtualMode) {
+            virtualTexture->bind(virtualProgram);
+            glUniform1f(glGetUniformLocation(virtualProgram, "uZoom"), virtualZoom);
+            glBindVertexArray(VAO[0]);
+            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        }
+        else if (draw) {
+            setLayer(WALL_LAYER);
             glBindVertexArray(VAO[0]);
             glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-            image_path = "cat.jpg";
-            data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-          
+            setLayer(CAT_LAYER);
             glBindVertexArray(VAO[1]);
             glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         }
         else {
+            setLayer(currentLayer);
             glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         }
 
@@ -276,8 +434,15 @@ int main() {
     glDeleteVertexArrays(2, VAO);
     glDeleteBuffers(2, VBO);
     glDeleteBuffers(2, EBO);
-    glDeleteTextures(1, &texture);
+    textureBudget.printStats();
+    textureLoader.printUploadStats();
+    textureLoader.shutdown();
+    virtualTexture->close();
+    virtualTexture.reset();
+    textureBudget.release(imageArray);
     glDeleteProgram(shaderProgram);
+    glDeleteProgram(virtualProgram);
+    glDeleteProgram(feedbackProgram);
 
     // Terminate GLFW
     glfwTerminate();
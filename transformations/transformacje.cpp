@@ -5,7 +5,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "../common/SceneGraph.h"
+#include "../common/TransformBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
 #include <vector>
 
 
@@ -13,6 +22,11 @@ unsigned int VBO, VAO, EBO;
 GLuint shaderProgram;
 glm::mat4 model = glm::mat4(1.0f);
 
+// bufory instancji: macierze (atrybuty 2..5, zmieniane co klatke) i kolory (atrybut 6, stale)
+GLuint instancedProgram, matrixVBO, colorVBO;
+std::vector<glm::mat4> instanceMatrices;
+std::vector<glm::vec3> instanceColors;
+
 const GLchar* vertexShaderSource =
 "#version 330 core\n"
 "layout(location = 0) in vec3 position;\n"
@@ -35,32 +49,33 @@ const GLchar* fragmentShaderSource =
     " fragmentColor = vec4(uColor, 1.0); \n"
 "}\0";
 
-int main()
-{
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    const unsigned int window_width = 1000;
-    const unsigned int window_height = 800;
-    GLFWwindow* window = glfwCreateWindow(window_width, window_height, "grafika komputerowa", NULL, NULL);
-    if (window == NULL)
-    {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
-    }
-    glfwMakeContextCurrent(window);
+// macierz modelu i kolor przychodza z bufora instancji, wszystkie trojkaty jednym wywolaniem
+const GLchar* instancedVertexShaderSource =
+"#version 330 core\n"
+"layout(location = 0) in vec3 position;\n"
+"layout(location = 1) in vec3 color;\n"
+"layout(location = 2) in mat4 instanceModel;\n"
+"layout(location = 6) in vec3 instanceColor;\n"
+"out vec3 vertexColor;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = instanceModel * vec4(position, 1.0);\n"
+"    vertexColor = instanceColor;\n"
+"}\0";
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
-    }
+const GLchar* instancedFragmentShaderSource =
+"#version 330 core\n"
+"in vec3 vertexColor;\n"
+"out vec4 fragmentColor;\n"
+"void main()\n"
+"{\n"
+"    fragmentColor = vec4(vertexColor, 1.0);\n"
+"}\0";
 
+GLuint buildProgram(const GLchar* vertexSource, const GLchar* fragmentSource)
+{
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
+    glShaderSource(vertexShader, 1, &vertexSource, NULL);
     glCompileShader(vertexShader);
 
     GLint status;
@@ -73,7 +88,7 @@ int main()
     }
 
     GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
     glCompileShader(fragmentShader);
 
     glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &status);
@@ -83,22 +98,278 @@ int main()
         std::cout << "Error (Fragment shader): " << error_message << std::endl;
     }
 
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
 
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &status);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
     if (!status)
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, error_message);
+        glGetProgramInfoLog(program, 512, NULL, error_message);
         std::cout << "Error (Shader program): " << error_message << std::endl;
     }
 
-    glDetachShader(shaderProgram, vertexShader);
-    glDetachShader(shaderProgram, fragmentShader);
+    glDetachShader(program, vertexShader);
+    glDetachShader(program, fragmentShader);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    return program;
+}
+
+// atrybuty instancji w VAO: mat4 zajmuje cztery lokacje (kolumny), kazda z dzielnikiem 1
+void setupInstanceAttributes(size_t count)
+{
+    glGenBuffers(1, &matrixVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, matrixVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    for (int column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribDivisor(2 + column, 1);
+    }
+
+    glGenBuffers(1, &colorVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, colorVBO);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), instanceColors.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+}
+
+// tryb --stress [N]: N trojkatow w siatce, kazdy z wlasna faza i predkoscia obrotu
+std::vector<float> stressBaseX, stressBaseY, stressPhase, stressSpin;
+float stressCell;
+
+void setupStress(TransformBatch& batch, int count)
+{
+    int columns = (int)std::ceil(std::sqrt((float)count));
+    stressCell = 2.0f / columns;
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    batch.resize(count);
+    instanceColors.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        stressBaseX.push_back(-1.0f + stressCell * (i % columns + 0.5f));
+        stressBaseY.push_back(1.0f - stressCell * (i / columns + 0.5f));
+        stressPhase.push_back(6.2831853f * unit(rng));
+        stressSpin.push_back(glm::radians(45.0f + 135.0f * unit(rng)) * (unit(rng) < 0.5f ? -1.0f : 1.0f));
+        instanceColors[i] = glm::vec3(unit(rng), unit(rng), unit(rng));
+    }
+}
+
+// ruch jak trojkat 4: przesuniecie po elipsie, obrot i pulsowanie, zakres wzgledem oczka siatki
+void animateStress(TransformBatch& batch, float time)
+{
+    float amplitude = 0.2f * stressCell, size = 1.6f * stressCell;
+    for (size_t i = 0; i < batch.size(); i++)
+    {
+        float phase = time + stressPhase[i];
+        batch.tx[i] = stressBaseX[i] + amplitude * std::cos(phase);
+        batch.ty[i] = stressBaseY[i] + 0.5f * amplitude * std::sin(phase);
+        batch.setRotationZ(i, stressSpin[i] * time);
+        batch.sx[i] = batch.sy[i] = batch.sz[i] = size * (0.5f + 0.2f * std::sin(phase));
+    }
+}
+
+// I: jedno glDrawElementsInstanced albo, dla porownania, glUniformMatrix4fv + glDrawElements na trojkat
+bool instancedDraw = true;
+
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    if (key == GLFW_KEY_I && action == GLFW_PRESS)
+    {
+        instancedDraw = !instancedDraw;
+        std::cout << (instancedDraw ? "Instanced: 1 draw call" : "One draw call per triangle") << std::endl;
+    }
+}
+
+// drzewo budowane w glab (dzieci zaraz za rodzicem), wiec add() tylko dopisuje na koniec tablicy
+void buildTree(SceneGraph& graph, SceneGraph::NodeId parent, int depth, int fanout, int& remaining, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (int k = 0; k < fanout && remaining > 0; k++)
+    {
+        Transform local;
+        local.translation = glm::vec3(unit(rng), unit(rng), unit(rng));
+        local.rotation = glm::angleAxis(3.14159265f * unit(rng), glm::vec3(0.0f, 0.0f, 1.0f));
+        local.scale = glm::vec3(0.9f + 0.1f * unit(rng));
+        SceneGraph::NodeId id = graph.add(parent, local);
+        remaining--;
+        if (depth > 1)
+            buildTree(graph, id, depth - 1, fanout, remaining, rng);
+    }
+}
+
+// tryb --bench-scene [--nodes N] [--frames F] [--moving P]: bez okna i GL, N wezlow w drzewie
+// o rozgalezieniu 10; co klatke P procent losowych wezlow dostaje nowa rotacje, update() liczy
+// tylko ich poddrzewa, dla porownania klatka z przeliczeniem calej sceny (zmiana wszystkich korzeni)
+int runSceneBenchmark(int nodes, int frames, float movingPercent)
+{
+    SceneGraph graph;
+    graph.reserve(nodes);
+    std::mt19937 rng(1234);
+    int remaining = nodes;
+    while (remaining > 0)
+        buildTree(graph, SceneGraph::ROOT, 6, 10, remaining, rng);
+
+    auto start = std::chrono::steady_clock::now();
+    graph.update();
+    double buildUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::uniform_int_distribution<int> pick(0, nodes - 1);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+    int moving = (int)(nodes * movingPercent / 100.0f);
+    double partialMs = 0.0;
+    size_t partialNodes = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (int k = 0; k < moving; k++)
+            graph.setRotation(pick(rng), glm::angleAxis(angle(rng), glm::vec3(0.0f, 0.0f, 1.0f)));
+        start = std::chrono::steady_clock::now();
+        partialNodes += graph.update();
+        partialMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double fullMs = 0.0;
+    size_t fullNodes = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        for (SceneGraph::NodeId id = 0; id < nodes; id++)
+            if (graph.parent(id) == SceneGraph::ROOT)
+                graph.setRotation(id, glm::angleAxis(angle(rng), glm::vec3(0.0f, 0.0f, 1.0f)));
+        start = std::chrono::steady_clock::now();
+        fullNodes += graph.update();
+        fullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::cout << "{\n"
+        << "  \"nodes\": " << nodes << ",\n"
+        << "  \"frames\": " << frames << ",\n"
+        << "  \"moving_per_frame\": " << moving << ",\n"
+        << "  \"first_update_ms\": " << buildUpdateMs << ",\n"
+        << "  \"partial_update_ms\": " << partialMs / frames << ",\n"
+        << "  \"partial_nodes_recomputed\": " << partialNodes / frames << ",\n"
+        << "  \"full_update_ms\": " << fullMs / frames << ",\n"
+        << "  \"full_nodes_recomputed\": " << fullNodes / frames << ",\n"
+        << "  \"ns_per_node\": " << fullMs * 1e6 / ((double)fullNodes) << "\n"
+        << "}" << std::endl;
+    return 0;
+}
+
+// tryb --bench-trs [--count N] [--repeat R]: macierze T * R * S dla N losowych obiektow,
+// glm::translate * glm::mat4_cast * glm::scale kontra TransformBatch::compose (SoA, SIMD);
+// max_error to najwieksza roznica elementu miedzy nimi
+int runComposeBenchmark(int count, int repeat)
+{
+    TransformBatch batch;
+    batch.resize(count);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (int i = 0; i < count; i++)
+    {
+        batch.tx[i] = unit(rng); batch.ty[i] = unit(rng); batch.tz[i] = unit(rng);
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng) + 2.0f));
+        glm::quat q = glm::angleAxis(3.14159265f * unit(rng), axis);
+        batch.qx[i] = q.x; batch.qy[i] = q.y; batch.qz[i] = q.z; batch.qw[i] = q.w;
+        batch.sx[i] = 1.0f + 0.5f * unit(rng); batch.sy[i] = 1.0f + 0.5f * unit(rng); batch.sz[i] = 1.0f + 0.5f * unit(rng);
+    }
+
+    std::vector<glm::mat4> expected(count), matrices(count);
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+        for (int i = 0; i < count; i++)
+        {
+            glm::quat q(batch.qw[i], batch.qx[i], batch.qy[i], batch.qz[i]);
+            expected[i] = glm::translate(glm::mat4(1.0f), glm::vec3(batch.tx[i], batch.ty[i], batch.tz[i]))
+                * glm::mat4_cast(q) * glm::scale(glm::mat4(1.0f), glm::vec3(batch.sx[i], batch.sy[i], batch.sz[i]));
+        }
+    double glmSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+        batch.compose(glm::value_ptr(matrices[0]));
+    double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    float maxError = 0.0f;
+    for (int i = 0; i < count; i++)
+        for (int c = 0; c < 4; c++)
+            for (int k = 0; k < 4; k++)
+                maxError = std::max(maxError, std::fabs(matrices[i][c][k] - expected[i][c][k]));
+
+    double matricesDone = (double)count * repeat;
+    std::cout << "{\n"
+        << "  \"count\": " << count << ",\n"
+        << "  \"repeat\": " << repeat << ",\n"
+        << "  \"path\": \"" << TransformBatch::composePath() << "\",\n"
+        << "  \"glm_ns_per_matrix\": " << glmSeconds * 1e9 / matricesDone << ",\n"
+        << "  \"batch_ns_per_matrix\": " << batchSeconds * 1e9 / matricesDone << ",\n"
+        << "  \"speedup\": " << glmSeconds / batchSeconds << ",\n"
+        << "  \"max_error\": " << maxError << "\n"
+        << "}" << std::endl;
+    return maxError < 1e-5f ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--bench-trs") == 0)
+    {
+        int count = 100000, repeat = 20;
+        for (int i = 2; i + 1 < argc; i++)
+        {
+            if (strcmp(argv[i], "--count") == 0) count = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--repeat") == 0) repeat = atoi(argv[++i]);
+        }
+        return runComposeBenchmark(count > 0 ? count : 1, repeat > 0 ? repeat : 1);
+    }
+
+    int stressCount = 0;
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--stress") == 0)
+            stressCount = i + 1 < argc && atoi(argv[i + 1]) > 0 ? atoi(argv[++i]) : 100000;
+    if (argc > 1 && strcmp(argv[1], "--bench-scene") == 0)
+    {
+        int nodes = 1000000, frames = 20;
+        float movingPercent = 1.0f;
+        for (int i = 2; i + 1 < argc; i++)
+        {
+            if (strcmp(argv[i], "--nodes") == 0) nodes = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--frames") == 0) frames = atoi(argv[++i]);
+            else if (strcmp(argv[i], "--moving") == 0) movingPercent = (float)atof(argv[++i]);
+        }
+        return runSceneBenchmark(nodes > 0 ? nodes : 1, frames > 0 ? frames : 1, movingPercent);
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    const unsigned int window_width = 1000;
+    const unsigned int window_height = 800;
+    GLFWwindow* window = glfwCreateWindow(window_width, window_height, "grafika komputerowa", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetKeyCallback(window, keyCallback);
+    // w tescie obciazeniowym bez vsync, czas klatki to koszt CPU/GPU
+    if (stressCount > 0)
+        glfwSwapInterval(0);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    shaderProgram = buildProgram(vertexShaderSource, fragmentShaderSource);
+    instancedProgram = buildProgram(instancedVertexShaderSource, instancedFragmentShaderSource);
 
     // Definicja wierzchokw i indeksw dla trjktw
     GLfloat vertices[] = {
@@ -128,6 +399,16 @@ int main()
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
     glEnableVertexAttribArray(1);
 
+    // stress: losowe kolory, inaczej kolory trojkatow 1..4 z dawnych glUniform3f(uColor)
+    TransformBatch stress;
+    if (stressCount > 0)
+        setupStress(stress, stressCount);
+    else
+        instanceColors = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 1.0f) };
+    size_t instanceCount = instanceColors.size();
+    instanceMatrices.resize(instanceCount);
+    setupInstanceAttributes(instanceCount);
+
     glBindVertexArray(0);
 
     glEnable(GL_DEPTH_TEST);
@@ -135,69 +416,113 @@ int main()
     glViewport(0, 0, (GLuint)window_width, (GLuint)window_height);
    
     GLint uColorLocation = glGetUniformLocation(shaderProgram, "uColor");
+    GLint modelLocation = glGetUniformLocation(shaderProgram, "model");
+
+    // naroznik okna jako rodzic, animowany trojkat jako jego dziecko: world = naroznik * T * R * S
+    SceneGraph scene;
+    const glm::vec3 corners[4] = {
+        glm::vec3(-0.6f, 0.6f, 0.0f), glm::vec3(0.6f, 0.6f, 0.0f),
+        glm::vec3(-0.6f, -0.6f, 0.0f), glm::vec3(0.6f, -0.6f, 0.0f)
+    };
+    SceneGraph::NodeId triangles[4];
+    for (int i = 0; i < 4; i++)
+    {
+        Transform corner;
+        corner.translation = corners[i];
+        triangles[i] = scene.add(scene.add(SceneGraph::ROOT, corner));
+    }
+    const glm::vec3 zAxis(0.0f, 0.0f, 1.0f);
+
+    double reportTime = glfwGetTime();
+    int reportFrames = 0;
 
     while (!glfwWindowShouldClose(window))
     {
         glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Ustawianie macierzy modelu dla kadego trjkta
-        glm::mat4 model1 = glm::translate(glm::mat4(1.0f), glm::vec3(-0.6f, 0.6f, 0.0f)); // lewy grny rg
-        glm::mat4 model2 = glm::translate(glm::mat4(1.0f), glm::vec3(0.6f, 0.6f, 0.0f));  // prawy grny rg
-        glm::mat4 model3 = glm::translate(glm::mat4(1.0f), glm::vec3(-0.6f, -0.6f, 0.0f)); // lewy dolny rg
-        glm::mat4 model4 = glm::translate(glm::mat4(1.0f), glm::vec3(0.6f, -0.6f, 0.0f));  // prawy dolny rg
-
-
         // Pobieranie czasu dla animacji
         float time = glfwGetTime();
 
-        // Trjkt 1: ruch w linii poziomej
-        float tx1 = 0.1f * cos(time); 
-        model1 = glm::translate(model1, glm::vec3(tx1, 0.0f, 0.0f));
-
-        // Trjkt 2: rotacja
-        float angle2 = time * glm::radians(90.0f);
-        model2 = glm::rotate(model2, angle2, glm::vec3(0.0f, 0.0f, 1.0f));
-
-        // Trjkt 3: naprzemienne zwikszanie i zmniejszanie rozmiaru
-        float scale3 = 0.5f + 0.2f * sin(time);
-        model3 = glm::scale(model3, glm::vec3(scale3, scale3, scale3));
-
-        // Trjkt 4: poczenie powyszych ruchw
-        float tx4 = 0.2f * cos(time);
-        float ty4 = 0.1f * sin(time);
-        float angle4 = time * glm::radians(90.0f);
-        float scale4 = 0.5f + 0.2f * sin(time);
-
-        model4 = glm::translate(model4, glm::vec3(tx4, ty4, 0.0f));
-        model4 = glm::rotate(model4, angle4, glm::vec3(0.0f, 0.0f, 1.0f));
-        model4 = glm::scale(model4, glm::vec3(scale4, scale4, scale4));
-      
-        glUseProgram(shaderProgram);
-
-        // Trjkt 1
-        glUniform3f(uColorLocation, 1.0f, 0.0f, 0.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model1));
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
-
-        // Trjkt 2
-        glUniform3f(uColorLocation, 1.0f, 1.0f, 0.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model2));
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
-
-        // Trjkt 3
-        glUniform3f(uColorLocation, 0.0f, 1.0f, 0.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model3));
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
-
-        // Trjkt 4
-        glUniform3f(uColorLocation, 1.0f, 0.0f, 1.0f);
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model4));
-        glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+        if (stressCount > 0)
+        {
+            animateStress(stress, time);
+        }
+        else
+        {
+            // Trjkt 1: ruch w linii poziomej
+            float tx1 = 0.1f * cos(time); 
+            scene.setTranslation(triangles[0], glm::vec3(tx1, 0.0f, 0.0f));
+
+            // Trjkt 2: rotacja
+            float angle2 = time * glm::radians(90.0f);
+            scene.setRotation(triangles[1], glm::angleAxis(angle2, zAxis));
+
+            // Trjkt 3: naprzemienne zwikszanie i zmniejszanie rozmiaru
+            float scale3 = 0.5f + 0.2f * sin(time);
+            scene.setScale(triangles[2], glm::vec3(scale3, scale3, scale3));
+
+            // Trjkt 4: poczenie powyszych ruchw
+            float tx4 = 0.2f * cos(time);
+            float ty4 = 0.1f * sin(time);
+            float angle4 = time * glm::radians(90.0f);
+            float scale4 = 0.5f + 0.2f * sin(time);
+
+            Transform local4;
+            local4.translation = glm::vec3(tx4, ty4, 0.0f);
+            local4.rotation = glm::angleAxis(angle4, zAxis);
+            local4.scale = glm::vec3(scale4, scale4, scale4);
+            scene.setLocal(triangles[3], local4);
+
+            // przeliczane sa tylko zmienione wezly (tu cztery trojkaty), narozniki zostaja z pierwszej klatki
+            scene.update();
+            for (int i = 0; i < 4; i++)
+                instanceMatrices[i] = scene.world(triangles[i]);
+        }
 
+        glBindVertexArray(VAO);
+        if (instancedDraw)
+        {
+            // bufor osierocony (INVALIDATE) i zapisany w calosci, stress liczy macierze prosto do niego
+            glBindBuffer(GL_ARRAY_BUFFER, matrixVBO);
+            float* mapped = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(glm::mat4),
+                GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            if (mapped)
+            {
+                if (stressCount > 0)
+                    stress.compose(mapped);
+                else
+                    memcpy(mapped, instanceMatrices.data(), instanceCount * sizeof(glm::mat4));
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+
+            glUseProgram(instancedProgram);
+            glDrawElementsInstanced(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0, (GLsizei)instanceCount);
+        }
+        else
+        {
+            if (stressCount > 0)
+                stress.compose(glm::value_ptr(instanceMatrices[0]));
+
+            glUseProgram(shaderProgram);
+            for (size_t i = 0; i < instanceCount; i++)
+            {
+                glUniform3fv(uColorLocation, 1, glm::value_ptr(instanceColors[i]));
+                glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(instanceMatrices[i]));
+                glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+            }
+        }
         glBindVertexArray(0);
 
+        reportFrames++;
+        if (stressCount > 0 && time - reportTime >= 1.0)
+        {
+            std::cout << instanceCount << " triangles, " << (instancedDraw ? 1 : instanceCount) << " draw calls: "
+                << 1000.0 * (time - reportTime) / reportFrames << " ms per frame" << std::endl;
+            reportTime = time;
+            reportFrames = 0;
+        }
+
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -205,7 +530,10 @@ int main()
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &matrixVBO);
+    glDeleteBuffers(1, &colorVBO);
     glDeleteProgram(shaderProgram);
+    glDeleteProgram(instancedProgram);
 
     glfwTerminate();
     return 0;
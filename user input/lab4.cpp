@@ -9,6 +9,10 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "../common/CircleMeshCache.h"
+#include "../common/TextureBudget.h"
+#include "../common/TextureLoader.h"
+
 const unsigned int window_width = 1000;
 const unsigned int window_height = 800;
 
@@ -17,10 +21,12 @@ int N = 10;
 GLuint VAO, VBO, EBO;
 GLuint shaderProgram;
 
-const GLchar* image_path;
+// car.jpg i wall.jpg w jednej tablicy tekstur, spacja zmienia tylko warstwe
+enum ImageLayer { CAR_LAYER = 0, WALL_LAYER = 1 };
+TextureSlot circleTexture;
 
-std::vector<float> vertices;
-std::vector<unsigned> indices;
+// wszystkie kola od 8 do 256 wierzcholkow w jednym VBO/EBO, scroll zmienia tylko zakres rysowania
+CircleMeshCache circleMeshes(r, 8, 256, true);
 
 const GLchar* vertexShaderSource =
 "#version 330 core\n"
@@ -37,61 +43,23 @@ const GLchar* fragmentShaderSource =
 "#version 330 core\n"
 "in vec2 vertexTexture;\n"
 "out vec4 fragmentColor;\n"
-"uniform sampler2D uTexture;\n"
+"uniform sampler2DArray uTexture;\n"
+"uniform int uLayer = 0;\n"
 "uniform vec3 uColor = vec3(0.5, 0.5, 0.5);"
 "void main()\n"
 "{\n"
-"   fragmentColor = texture(uTexture, vertexTexture.xy) * vec4(uColor, 1.0);\n"
+"   fragmentColor = texture(uTexture, vec3(vertexTexture.xy, uLayer)) * vec4(uColor, 1.0);\n"
 "}\0";
 
-void createCircle(float r, float N) {
-    float phi = 360.f / N;
-    int triangleCount = N - 2;
-    float toRadians = 3.1415f / 180.f;
-
-    vertices.clear();
-    indices.clear();
-
-    for (int i = 0; i < N; i++) {
-        float currentPhi = phi * i;
-        float x = r * cos(currentPhi * toRadians);
-        float y = r * sin(currentPhi * toRadians);
-        float z = 0.0f;
-        float textureX = (cos(currentPhi * toRadians) + 1.0f) / 2.0f;   // mapping
-        float textureY = (sin(currentPhi * toRadians) + 1.0f) / 2.0f;
-        vertices.push_back(x);
-        vertices.push_back(y);
-        vertices.push_back(z);
-        vertices.push_back(textureX);
-        vertices.push_back(textureY);
-    }
-    for (int i = 0; i < triangleCount; i++) {
-        indices.push_back(0);
-        indices.push_back(i + 1);
-        indices.push_back(i + 2);
-    }
-}
-
 // scroll callback - powiekszanie kola scrollem
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
     if (yoffset > 0) {
         N++;
     }
     else {
-        if (N > 8) {
-            N--;
-        }
+        N--;
     }
-
-    createCircle(r, N);
-
-    // aktualizacja buforow wierzcholkow
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
- 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned) * indices.size(), &indices[0], GL_STATIC_DRAW);
-
+    N = circleMeshes.clamp(N);
 }
 
 bool pressed = 0;
@@ -117,27 +85,16 @@ void processInputKeyboard(GLFWwindow* window) {
     double currentTime = glfwGetTime();
    
     if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && (currentTime - lastKeyPressTime) > debounceDelay) {
+        GLint uLayerLocation = glGetUniformLocation(shaderProgram, "uLayer");
         if (!pressed) {
-            image_path = "wall.jpg";
+            glUniform1i(uLayerLocation, WALL_LAYER);
             pressed = 1;
         }
         else {
-            image_path = "car.jpg";
+            glUniform1i(uLayerLocation, CAR_LAYER);
             pressed = 0;
         }
         lastKeyPressTime = currentTime;
-
-        GLint width, height, nrChannels;
-         stbi_set_flip_vertically_on_load(true);
-        GLubyte* data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-        if (data) {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else {
-            std::cout << "Failed to load texture" << std::endl;
-        }
-        stbi_image_free(data);
     }
 }
 
@@ -165,34 +122,16 @@ int main() {
     glViewport(0, 0, (GLuint)window_width, (GLuint)window_height);
 
     // TEXTURE SETUP //
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-    GLint width, height, nrChannels;
     stbi_set_flip_vertically_on_load(true);
-    image_path = "car.jpg";
-    GLubyte* data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    TextureLoader textureLoader;
+    TextureBudget textureBudget(textureLoader, 64 * 1024 * 1024);
+    textureBudget.loadArray(circleTexture, { "car.jpg", "wall.jpg" });
 
     // aktywowanie funkcji
     glfwSetScrollCallback(window, scrollCallback);
 
     // cirle setup
     std::cout << "r = " << r;
-    createCircle(r, N);
 
     /* SHADERS */
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -221,11 +160,7 @@ int main() {
     glGenBuffers(1, &EBO);
     glBindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
-  
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &indices[0], GL_STATIC_DRAW);
+    circleMeshes.upload(VBO, EBO);
 
     // position
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -258,11 +193,14 @@ int main() {
         glClearColor(0.7f, 0.0f, 1.f, 1.f);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        textureLoader.update();
+        textureBudget.update();
+
         // Renderowanie koa
-        glBindTexture(GL_TEXTURE_2D, texture);
+        textureBudget.bind(circleTexture);
         glUseProgram(shaderProgram);
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        circleMeshes.draw(N);
 
         processInputKeyboard(window);
         glfwSwapBuffers(window);
@@ -272,6 +210,9 @@ int main() {
     glDeleteBuffers(1, &VBO);
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &EBO);
+    textureBudget.printStats();
+    textureLoader.shutdown();
+    textureBudget.release(circleTexture);
     glDeleteProgram(shaderProgram);
 
     // Zakoczenie dziaania GLFW